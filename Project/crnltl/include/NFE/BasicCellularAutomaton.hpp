@@ -0,0 +1,232 @@
+#ifndef NFE_BASIC_CELLULAR_AUTOMATON_HPP
+#define NFE_BASIC_CELLULAR_AUTOMATON_HPP
+
+#include <NFE/Cell.hpp>
+#include <SFML3D/System/Vector2.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace NFE
+{
+    // The stepping kernel shared by every automaton. The transition, the life rule and the stencil that gathers
+    // the neighbors of a cell are template parameters, so that a rule known at compile time is inlined into the loop.
+    // A Stencil provides the Board, Position and Neighbors types along with
+    // getCapacity(board), getPosition(board, i, position), getCell(board, position) and gather(board, position, cell, neighbors).
+    template <class TransitionFn, class LifeFn, class Stencil>
+    class BasicCellularAutomaton
+    {
+        public:
+            typedef typename Stencil::Board Board;
+            typedef typename Stencil::Position Position;
+            typedef typename Stencil::Neighbors Neighbors;
+            BasicCellularAutomaton(const TransitionFn& transition = TransitionFn(), const LifeFn& life = LifeFn(), const Stencil& stencil = Stencil()) :
+                transition(transition),
+                life(life),
+                stencil(stencil)
+            {
+
+            }
+            bool getNextState(const Board& board, const Position& position, Neighbors& neighbors, unsigned int& state) const
+            {
+                const Cell& cell = stencil.getCell(board,position);
+                if (!stencil.gather(board,position,cell,neighbors))
+                {
+                    return false;
+                }
+                state = transition(cell,neighbors);
+                return true;
+            }
+            void update(Cell& cell, unsigned int state) const
+            {
+                if (life(cell,state))
+                {
+                    cell.setLife(cell.getLife()+1);
+                }
+                else
+                {
+                    cell.setLife(0);
+                    cell.setState(state);
+                }
+            }
+            void step(const Board& source, Board& target) const
+            {
+                Neighbors neighbors = Neighbors();
+                Position position;
+                unsigned int state;
+                for (std::size_t i = 0; i != stencil.getCapacity(source); ++i)
+                {
+                    if (!stencil.getPosition(source,i,position))
+                    {
+                        continue;
+                    }
+                    if (getNextState(source,position,neighbors,state))
+                    {
+                        Cell& next = stencil.getCell(target,position);
+                        next = stencil.getCell(source,position);
+                        update(next,state);
+                    }
+                }
+            }
+            const TransitionFn& getTransition() const
+            {
+                return transition;
+            }
+            const LifeFn& getLife() const
+            {
+                return life;
+            }
+            const Stencil& getStencil() const
+            {
+                return stencil;
+            }
+        private:
+            TransitionFn transition;
+            LifeFn life;
+            Stencil stencil;
+    };
+
+    // A flat board of cells stored by value, in the same x-major order as a row major Grid.
+    class ArrayBoard
+    {
+        public:
+            ArrayBoard(const sf3d::Vector2u& size = sf3d::Vector2u(), const Cell& fill = Cell()) :
+                size(size),
+                cells(static_cast<std::size_t>(size.x)*size.y,fill)
+            {
+
+            }
+            const sf3d::Vector2u& getSize() const
+            {
+                return size;
+            }
+            Cell& getCell(unsigned int x, unsigned int y)
+            {
+                return cells[(static_cast<std::size_t>(x)*size.y)+y];
+            }
+            const Cell& getCell(unsigned int x, unsigned int y) const
+            {
+                return cells[(static_cast<std::size_t>(x)*size.y)+y];
+            }
+            std::vector<Cell>& getCells()
+            {
+                return cells;
+            }
+            const std::vector<Cell>& getCells() const
+            {
+                return cells;
+            }
+        private:
+            sf3d::Vector2u size;
+            std::vector<Cell> cells;
+    };
+
+    // Counts the cells of non-zero state in the square of the given radius around a cell of a TORUS shaped ArrayBoard.
+    // The radius has to be smaller than the board on both axes.
+    template <unsigned int RADIUS>
+    class MooreStencil
+    {
+        public:
+            typedef ArrayBoard Board;
+            typedef std::size_t Position;
+            typedef unsigned int Neighbors;
+            std::size_t getCapacity(const Board& board) const
+            {
+                return board.getCells().size();
+            }
+            bool getPosition(const Board&, std::size_t index, Position& position) const
+            {
+                position = index;
+                return true;
+            }
+            Cell& getCell(Board& board, const Position& position) const
+            {
+                return board.getCells()[position];
+            }
+            const Cell& getCell(const Board& board, const Position& position) const
+            {
+                return board.getCells()[position];
+            }
+            bool gather(const Board& board, const Position& position, const Cell& cell, Neighbors& neighbors) const
+            {
+                const int radius = static_cast<int>(RADIUS);
+                const int width = static_cast<int>(board.getSize().x);
+                const int height = static_cast<int>(board.getSize().y);
+                const int x = static_cast<int>(position/board.getSize().y);
+                const int y = static_cast<int>(position%board.getSize().y);
+                const Cell* cells = board.getCells().data();
+                const Cell* column;
+                int other;
+                // the loops below also visit the cell itself, so a live cell starts one below zero
+                neighbors = (cell.getState() != 0)?0u-1u:0u;
+                for (int i = -radius; i != radius+1; ++i)
+                {
+                    other = x+i;
+                    if (other < 0)
+                    {
+                        other += width;
+                    }
+                    else if (other >= width)
+                    {
+                        other -= width;
+                    }
+                    column = cells+(static_cast<std::size_t>(other)*height);
+                    if ((y >= radius) && (y+radius < height))
+                    {
+                        // the contiguous case, a plain reduction the compiler can vectorize
+                        for (int j = y-radius; j != y+radius+1; ++j)
+                        {
+                            neighbors += (column[j].getState() != 0)?1u:0u;
+                        }
+                    }
+                    else
+                    {
+                        for (int j = -radius; j != radius+1; ++j)
+                        {
+                            other = y+j;
+                            if (other < 0)
+                            {
+                                other += height;
+                            }
+                            else if (other >= height)
+                            {
+                                other -= height;
+                            }
+                            neighbors += (column[other].getState() != 0)?1u:0u;
+                        }
+                    }
+                }
+                return true;
+            }
+    };
+
+    struct ConwayTransition
+    {
+        unsigned int operator()(const Cell& cell, unsigned int neighbors) const
+        {
+            if (cell.getState() == 0)
+            {
+                return (neighbors == 3)?1:0;
+            }
+            if (cell.getState() == 1)
+            {
+                return ((neighbors == 2) || (neighbors == 3))?1:0;
+            }
+            return 0;
+        }
+    };
+
+    // The default life rule of CellularAutomaton, a cell ages while its state is kept.
+    struct SameStateLife
+    {
+        bool operator()(const Cell& cell, unsigned int state) const
+        {
+            return (state == cell.getState());
+        }
+    };
+
+    // Steps a TORUS board like CellularAutomaton::getConwayGameOfLife. bench::compareConway() compares the two
+    // on the same board, mismatched cells and time per generation.
+    typedef BasicCellularAutomaton<ConwayTransition,SameStateLife,MooreStencil<1>> BasicConwayGameOfLife;
+}
+
+#endif // NFE_BASIC_CELLULAR_AUTOMATON_HPP
@@ -0,0 +1,19 @@
+#ifndef NFE_BENCHMARK_HPP
+#define NFE_BENCHMARK_HPP
+
+#include <functional>
+#include <ostream>
+
+namespace NFE
+{
+    // Timings kept apart from the automata they measure, run from main when CRNLTL_BENCHMARK is set.
+    namespace bench
+    {
+        // Best mean time of one generation, in milliseconds, over a few rounds of the given number of generations.
+        double timeGenerations(const std::function<void()>& step, unsigned int generations, unsigned int rounds = 3);
+        // Steps the dynamic Conway automaton and BasicConwayGameOfLife from the same board, and reports the cells they disagree on.
+        void compareConway(std::ostream& output);
+    }
+}
+
+#endif // NFE_BENCHMARK_HPP
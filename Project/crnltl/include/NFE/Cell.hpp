@@ -0,0 +1,41 @@
+#ifndef NFE_CELL_HPP
+#define NFE_CELL_HPP
+
+namespace NFE
+{
+    class Cell
+    {
+        public:
+            Cell(unsigned int state = 0, unsigned int life = 0) :
+                state(state),
+                life(life)
+            {
+
+            }
+            ~Cell()
+            {
+
+            }
+            unsigned int getState() const
+            {
+                return state;
+            }
+            void setState(unsigned int state)
+            {
+                this->state = state;
+            }
+            unsigned int getLife() const
+            {
+                return life;
+            }
+            void setLife(unsigned int life)
+            {
+                this->life = life;
+            }
+        private:
+            unsigned int state;
+            unsigned int life;
+    };
+}
+
+#endif // NFE_CELL_HPP
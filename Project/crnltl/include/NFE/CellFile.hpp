@@ -0,0 +1,38 @@
+#ifndef NFE_CELL_FILE_HPP
+#define NFE_CELL_FILE_HPP
+
+#include <NFE/CellularAutomaton.hpp>
+#include <NFE/MappedFile.hpp>
+
+namespace NFE
+{
+    // A memory mapped state file for boards that do not fit in memory.
+    // After a 16 byte header (magic, version, width, height) each cell is stored as a
+    // (state, life) pair of 32 bit integers, one row of constant y after the other,
+    // so that a horizontal band of the board is a contiguous range of the file.
+    class CellFile
+    {
+        public:
+            static const std::uint32_t MAGIC = 0x4345464E;
+            static const std::uint32_t VERSION = 1;
+            CellFile();
+            virtual ~CellFile();
+            bool create(const std::string& path, const sf3d::Vector2u& size);
+            bool open(const std::string& path, bool writable = false);
+            void close();
+            bool flush();
+            void advise(unsigned int row, unsigned int count, MappedFile::Advice advice) const;
+            bool isOpen() const;
+            bool isWritable() const;
+            const sf3d::Vector2u& getSize() const;
+            std::uint32_t* getRow(unsigned int row) const;
+            bool store(const CellularAutomaton::Cells* cells);
+            bool load(CellularAutomaton::Cells* cells) const;
+        private:
+            std::uint64_t getRowOffset(unsigned int row) const;
+            MappedFile file;
+            sf3d::Vector2u size;
+    };
+}
+
+#endif // NFE_CELL_FILE_HPP
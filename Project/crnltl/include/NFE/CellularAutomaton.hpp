@@ -1,30 +1,22 @@
 #ifndef NFE_CELLULAR_AUTOMATON_HPP
 #define NFE_CELLULAR_AUTOMATON_HPP
 
+#include <NFE/BasicCellularAutomaton.hpp>
 #include <NFE/Repository.hpp>
 #include <NFE/Random.hpp>
 #include <NFE/Grid.hpp>
 #include <functional>
+#include <deque>
 #include <map>
 
 namespace NFE
 {
+    class CellFile;
+
     class CellularAutomaton
     {
         public:
-            class Cell
-            {
-                public:
-                    Cell(unsigned int state = 0, unsigned int life = 0);
-                    ~Cell();
-                    unsigned int getState() const;
-                    void setState(unsigned int state);
-                    unsigned int getLife() const;
-                    void setLife(unsigned int life);
-                private:
-                    unsigned int state;
-                    unsigned int life;
-            };
+            typedef NFE::Cell Cell;
             struct STATE_LIFE_RULE {};
             struct TRANSITION_RULE {};
             struct NEIGHBORHOODS_RULE {};
@@ -53,6 +45,17 @@ namespace NFE
             typedef RepositorySlot<CascadeStateMap,OUTBOUND_CASCADE_STATE_MAP_RULE> OutboundCascadeStateMapRuleSlot;
             typedef Repository<StateLifeRuleSlot,TransitionRuleSlot,NeighborhoodsRuleSlot,NeighborhoodRadiusRuleSlot,InboundCascadeStateMapRuleSlot,OutboundCascadeStateMapRuleSlot> Rules;
             typedef std::pair<CellularAutomaton*,CellularAutomaton*> CascadePair;
+            // An immutable copy of the board as of one generation, published for readers on other threads.
+            // The number counts every generation stepped since construction, so a reader can tell a stale copy apart.
+            struct Generation
+            {
+                std::uint64_t number;
+                std::uint64_t stateHash;
+                ArrayBoard board;
+            };
+            struct PUBLISHED_GENERATION {};
+            typedef RepositorySlot<const Generation,PUBLISHED_GENERATION> PublishedGenerationSlot;
+            typedef Repository<PublishedGenerationSlot> Publications;
             CellularAutomaton();
             CellularAutomaton(const sf3d::Vector2u& size);
             CellularAutomaton(const sf3d::Vector2u& size, unsigned int states, Random* random);
@@ -62,6 +65,8 @@ namespace NFE
             void accomodateNewTransitionRule(Transition transition);
             void accomodateNewState(unsigned int newState, Transition transition);
             void goToNextGeneration();
+            void advance(unsigned int generations);
+            bool goToNextGeneration(const CellFile& source, CellFile& target, unsigned int band = 256);
             void setNeighborhoodStyle(Neighborhood::Style style);
             void setNeighborhoodCache(bool cache);
             void setTopology(Topology topology);
@@ -75,16 +80,36 @@ namespace NFE
             void setGenerationLoop(unsigned int generationLoop);
             unsigned int getGenerationLoop() const;
             unsigned int getGenerationCount() const;
+            void setCycleDetection(unsigned int history);
+            unsigned int getCycleDetection() const;
+            unsigned int getPeriod() const;
+            std::uint64_t getStateHash(bool life = false) const;
+            // While publication is on every step copies the board for getPublished(), so it is best left off when nothing reads.
+            void setPublication(bool publication);
+            bool getPublication() const;
+            std::uint64_t getGenerationNumber() const;
+            // The copy is not pinned, a reader may keep it for as long as it likes.
+            std::shared_ptr<const Generation> getPublished() const;
+            PublishedGenerationSlot::WatcherTypePtr getPublicationWatcher();
             unsigned int getStateCount() const;
             unsigned int getCellsOfStateCount(unsigned int state) const;
+            unsigned int getNeighborhoodReach() const;
+            // Changes the state of one cell and keeps the state hash in step, which writing through getCells() does not.
+            void setState(const sf3d::Vector2u& index, unsigned int state);
+            // Meant for reading. A state written through the payloads leaves getStateHash() and cycle detection stale
+            // until the next create(), so edits go through setState().
             const Cells* getCells() const;
             sf3d::Image* getLifeImage(const sf3d::Color& old, const sf3d::Color& young) const;
             sf3d::Image* getImage(bool life = true) const;
             std::string getRulesString();
+            // Rules are changed by setting or emplacing a new value in their slot. A container edited in place
+            // through get() is not seen by the automaton, which keeps pointers into the value it last read.
             Rules* getRules() const;
             Cells* getNextGeneration();
+            // Sees the rules of the generation being stepped, or the latest ones when called between generations.
             virtual bool getNeighbors(const Cell* cell, const sf3d::Vector2u& index, Neighbors& neighbors);
             static sf3d::Color getColorFromKey(int key);
+            static sf3d::Color getCellColor(const Cell& cell, bool life = true);
             static sf3d::Color mixColors(const sf3d::Color& color1, const sf3d::Color& color2, float key, bool alpha);
             static CellularAutomaton* getMorphogenesis(const sf3d::Vector2u& size, Random* random = nullptr, float inhibition = 0.2f, const sf3d::Vector2f& inhibitionRange = sf3d::Vector2f(6.1f,6.1f), const sf3d::Vector2f& activationRange = sf3d::Vector2f(2.3f,2.3f));
             static CellularAutomaton* getFingerprintGame(const sf3d::Vector2u& size, Random* random = nullptr);
@@ -93,13 +118,140 @@ namespace NFE
             static std::string getRuleString(const std::shared_ptr<Rule> rule);
             static std::string getRulesString(Rules& rules);
             static Rule getNeighborsOfState(const Neighbors& neighbors, unsigned int state);
+            static bool hasNeighborsOfState(const Neighbors& neighbors, unsigned int state);
             static void freeCascadePairs(const std::vector<CascadePair>& cascadePairs);
         protected:
             void update(const Cells* cells, std::shared_ptr<CascadeStateMap> cascadeStateMap);
             void update(const Cells* cells, bool cascade = false);
-            void update(Cell* cell, unsigned int state);
+            void update(Cell* cell, const sf3d::Vector2u& index, unsigned int state);
         private:
+            // The rules as seen by one generation, refreshed through the watchers only when a slot was set.
+            struct Snapshot
+            {
+                std::shared_ptr<StateLife> stateLife;
+                std::shared_ptr<Transition> transition;
+                std::shared_ptr<Neighborhoods> neighborhoods;
+                std::shared_ptr<NeighborhoodRadius> neighborhoodRadius;
+                std::vector<const StateRadius*> stateRadius;
+            };
+            // One step of a transition built by accomodateNewState or accomodateNewTransitionRule.
+            struct TransitionLayer
+            {
+                enum Kind
+                {
+                    STATE,
+                    TRANSITION
+                };
+                Kind kind;
+                unsigned int state;
+                Transition transition;
+            };
+            typedef std::vector<TransitionLayer> TransitionLayers;
+            // The dynamic instantiation of the stepping kernel, dispatching through the rules and getNeighbors().
+            struct DynamicTransition
+            {
+                unsigned int operator()(const Cell& cell, const Neighbors& neighbors) const
+                {
+                    return (*transition)(cell,neighbors);
+                }
+                const Transition* transition;
+            };
+            struct DynamicLife
+            {
+                bool operator()(const Cell& cell, unsigned int state) const
+                {
+                    return (*stateLife)(cell,state);
+                }
+                const StateLife* stateLife;
+            };
+            struct DynamicStencil
+            {
+                typedef CellularAutomaton::Cells Board;
+                typedef sf3d::Vector2u Position;
+                typedef CellularAutomaton::Neighbors Neighbors;
+                std::size_t getCapacity(const Board& board) const
+                {
+                    return board.getCapacity();
+                }
+                bool getPosition(const Board& board, std::size_t index, Position& position) const
+                {
+                    return board.getIndex(static_cast<unsigned int>(index),position);
+                }
+                Cell& getCell(const Board& board, const Position& position) const
+                {
+                    return *board.getUnit(position)->getPayload();
+                }
+                bool gather(const Board&, const Position& position, const Cell& cell, Neighbors& neighbors) const
+                {
+                    neighbors.clear();
+                    return automaton->getNeighbors(&cell,position,neighbors);
+                }
+                CellularAutomaton* automaton;
+            };
+            typedef BasicCellularAutomaton<DynamicTransition,DynamicLife,DynamicStencil> Kernel;
+            // The instantiation stepping a band of a CellFile, held by value in an ArrayBoard. The neighborhoods are
+            // mapped on a geometry grid of the band's size that holds no cells, and only the rows from first to last are stepped.
+            struct BandStencil
+            {
+                typedef ArrayBoard Board;
+                typedef std::size_t Position;
+                typedef CellularAutomaton::Neighbors Neighbors;
+                std::size_t getCapacity(const Board& board) const
+                {
+                    return board.getCells().size();
+                }
+                bool getPosition(const Board& board, std::size_t index, Position& position) const
+                {
+                    std::size_t y = index%board.getSize().y;
+                    position = index;
+                    return ((y >= first) && (y < last));
+                }
+                Cell& getCell(Board& board, const Position& position) const
+                {
+                    return board.getCells()[position];
+                }
+                const Cell& getCell(const Board& board, const Position& position) const
+                {
+                    return board.getCells()[position];
+                }
+                bool gather(const Board& board, const Position& position, const Cell& cell, Neighbors& neighbors) const
+                {
+                    neighbors.clear();
+                    return automaton->getNeighbors(board,geometry,sf3d::Vector2u(static_cast<unsigned int>(position/board.getSize().y),static_cast<unsigned int>(position%board.getSize().y)),cell,neighbors);
+                }
+                CellularAutomaton* automaton;
+                const Cells* geometry;
+                std::size_t first;
+                std::size_t last;
+            };
+            typedef BasicCellularAutomaton<DynamicTransition,DynamicLife,BandStencil> BandKernel;
+            Kernel getKernel();
+            bool getNeighbors(const ArrayBoard& band, const Cells* geometry, const sf3d::Vector2u& index, const Cell& cell, Neighbors& neighbors);
             void initialize(const sf3d::Vector2u& size);
+            void takeSnapshot();
+            void accomodate(const TransitionLayer& layer);
+            void update(const Kernel& kernel, Cell* cell, const sf3d::Vector2u& index, unsigned int state);
+            void setState(Cell* cell, const sf3d::Vector2u& index, unsigned int state);
+            void resetStateHash();
+            std::uint64_t getStateKey(const sf3d::Vector2u& index, unsigned int state) const;
+            std::uint64_t getLifeKey(const sf3d::Vector2u& index, unsigned int life) const;
+            void resetCycle();
+            bool replayCycle();
+            void recordCycle();
+            void skipCycle(unsigned int generations);
+            std::uint64_t getRulesVersion() const;
+            std::vector<unsigned int> getStates() const;
+            // The generations readers have let go of, filled again by publish() rather than reallocated.
+            // Shared with the deleters of the published copies, which may outlive the automaton.
+            struct GenerationPool
+            {
+                static const unsigned int SIZE = 4;
+                GenerationPool();
+                ~GenerationPool();
+                std::atomic<Generation*> generations[SIZE];
+            };
+            void publish();
+            static Transition getLayeredTransition(const Transition& base, std::shared_ptr<const TransitionLayers> layers);
             unsigned int generationLoop;
             unsigned int generationCount;
             bool cellReusabilityPolicy;
@@ -107,6 +259,27 @@ namespace NFE
             CellularAutomaton* cascadeTarget;
             Rules* rules;
             Cells* cells;
+            Snapshot snapshot;
+            bool snapshotHeld;
+            Transition transitionBase;
+            TransitionLayers transitionLayers;
+            std::shared_ptr<Transition> transitionLayered;
+            std::shared_ptr<StateLife> stateLifeDefault;
+            std::uint64_t stateHash;
+            unsigned int cycleHistory;
+            unsigned int cyclePhase;
+            std::uint64_t cycleRulesVersion;
+            std::deque<std::vector<unsigned int>> cycleFrames;
+            std::deque<std::uint64_t> cycleHashes;
+            std::vector<std::vector<unsigned int>> cycle;
+            bool publication;
+            std::shared_ptr<GenerationPool> generationPool;
+            std::uint64_t generationNumber;
+            mutable Publications publications;
+            WatcherPtr<StateLife,STATE_LIFE_RULE> stateLifeWatcher;
+            WatcherPtr<Transition,TRANSITION_RULE> transitionWatcher;
+            WatcherPtr<Neighborhoods,NEIGHBORHOODS_RULE> neighborhoodsWatcher;
+            WatcherPtr<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE> neighborhoodRadiusWatcher;
     };
 }
 
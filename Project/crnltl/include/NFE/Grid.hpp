@@ -3,7 +3,9 @@
 
 #include <NFE/MathUtilities.hpp>
 #include <SFML3D/Graphics/Image.hpp>
+#include <algorithm>
 #include <map>
+#include <new>
 #include <set>
 
 namespace NFE
@@ -48,7 +50,7 @@ namespace NFE
                     }
                     float getDirection(Unit* other) const
                     {
-                        return getDirection(sf3d::Vector2f(index),sf3d::Vector2f(getRelativeIndex(other)));
+                        return util::getDirection(sf3d::Vector2f(index),sf3d::Vector2f(getRelativeIndex(other)));
                     }
                     float getDistance(Unit* other) const
                     {
@@ -218,10 +220,13 @@ namespace NFE
                     typedef std::map<Style,IndexLeftMap> StyleMap;
                     typedef std::map<Topology,StyleMap> TopologyMap;
                     typedef std::map<const Grid*,TopologyMap> Bank;
+                    typedef std::map<bool,RadiusLeftMap> StencilMap;
+                    typedef std::map<Style,RadiusLeftMap> StyleStencilMap;
                     Neighborhood(Style style = MOORE, bool cache = false) :
-                        style(style),
-                        bank(nullptr),
                         relativity(false),
+                        cache(false),
+                        bank(nullptr),
+                        style(style),
                         origin()
                     {
                         setCache(cache);
@@ -303,122 +308,11 @@ namespace NFE
                                     position.y += y;
                                     temp.x = position.x;
                                     temp.y = position.y;
-                                    if (!relativity)
+                                    if ((relativity) || (mapPosition(grid,bounds,position)))
                                     {
-                                        if ((position.x < 0) || (position.x >= grid->getSize().x) || (position.y < 0) || (position.y >= grid->getSize().y))
+                                        if (contains(temp-sf3d::Vector2i(index),radius))
                                         {
-                                            if ((bounds.x >= static_cast<int>(grid->getSize().x)) || (bounds.y >= static_cast<int>(grid->getSize().y)))
-                                            {
-                                                position = sf3d::Vector2i(grid->getAbsoluteIndex(position));
-                                            }
-                                            else
-                                            {
-                                                switch (grid->getTopology())
-                                                {
-                                                case TORUS:
-                                                    if (position.x < 0)
-                                                    {
-                                                        position.x += static_cast<int>(grid->getSize().x);
-                                                    }
-                                                    if (position.x >= static_cast<int>(grid->getSize().x))
-                                                    {
-                                                        position.x -= static_cast<int>(grid->getSize().x);
-                                                    }
-                                                    if (position.y < 0)
-                                                    {
-                                                        position.y += static_cast<int>(grid->getSize().y);
-                                                    }
-                                                    if (position.y >= static_cast<int>(grid->getSize().y))
-                                                    {
-                                                        position.y -= static_cast<int>(grid->getSize().y);
-                                                    }
-                                                    break;
-                                                case SPHERE:
-                                                    if (position.x < 0)
-                                                    {
-                                                        position.x += static_cast<int>(grid->getSize().x);
-                                                    }
-                                                    if (position.x >= static_cast<int>(grid->getSize().x))
-                                                    {
-                                                        position.x -= static_cast<int>(grid->getSize().x);
-                                                    }
-                                                    if (position.y < 0)
-                                                    {
-                                                        position.x = (position.x+(static_cast<int>(grid->getSize().x)/2))%static_cast<int>(grid->getSize().x);
-                                                        position.y = 0-(position.y-0);
-                                                    }
-                                                    if (position.y >= static_cast<int>(grid->getSize().y))
-                                                    {
-                                                        position.x = (position.x+(static_cast<int>(grid->getSize().x)/2))%static_cast<int>(grid->getSize().x);
-                                                        position.y = (static_cast<int>(grid->getSize().y)-1)-(position.y-static_cast<int>(grid->getSize().y));
-                                                    }
-                                                    break;
-                                                case PLANE:
-                                                    break;
-                                                case QUINCUNCIAL:
-                                                    {
-                                                        bool horizontal = false;
-                                                        bool vertical = false;
-                                                        if (position.x < 0)
-                                                        {
-                                                            position.x = 0-(position.x-0);
-                                                            horizontal = true;
-                                                        }
-                                                        if (position.x >= static_cast<int>(grid->getSize().x))
-                                                        {
-                                                            position.x = (static_cast<int>(grid->getSize().x)-1)-(position.x-static_cast<int>(grid->getSize().x));
-                                                            horizontal = true;
-                                                        }
-                                                        if (position.y < 0)
-                                                        {
-                                                            position.y = 0-(position.y-0);
-                                                            vertical = true;
-                                                        }
-                                                        if (position.y >= static_cast<int>(grid->getSize().y))
-                                                        {
-                                                            position.y = (static_cast<int>(grid->getSize().y)-1)-(position.y-static_cast<int>(grid->getSize().y));
-                                                            vertical = true;
-                                                        }
-                                                        if (horizontal)
-                                                        {
-                                                            position.x = (static_cast<int>(grid->getSize().x)-1)-position.x;
-                                                        }
-                                                        if (vertical)
-                                                        {
-                                                            position.y = (static_cast<int>(grid->getSize().y)-1)-position.y;
-                                                        }
-                                                    }
-                                                    break;
-                                                }
-                                            }
-                                        }
-                                    }
-                                    if ((relativity) || ((position.x >= 0) && (position.x < grid->getSize().x) && (position.y >= 0) && (position.y < grid->getSize().y)))
-                                    {
-                                        switch (style)
-                                        {
-                                        case MOORE:
                                             contents.push_back(position);
-                                            break;
-                                        case VON_NEUMANN:
-                                            if (util::getManhattanDistance(sf3d::Vector2f(temp),sf3d::Vector2f(index)) < radius.x+0.5f)
-                                            {
-                                                contents.push_back(position);
-                                            }
-                                            break;
-                                        case EUCLID:
-                                            if (util::getDistance(sf3d::Vector2f(temp),sf3d::Vector2f(index)) < radius.x+0.5f)
-                                            {
-                                                contents.push_back(position);
-                                            }
-                                            break;
-                                        case MENAECHMUS:
-                                            if ((util::sqr(static_cast<float>(index.x)-static_cast<float>(temp.x))/util::sqr(radius.x))+
-                                                (util::sqr(static_cast<float>(index.y)-static_cast<float>(temp.y))/util::sqr(radius.y)) < 1.0f)
-                                            {
-                                                contents.push_back(position);
-                                            }
-                                            break;
                                         }
                                     }
                                 }
@@ -539,6 +433,240 @@ namespace NFE
                         findOrthogonalComplement(grid,index,sf3d::Vector2f(radius,radius),reorder);
                     }
                     void findOrthogonalComplement(const Grid* grid, const sf3d::Vector2u& index, const sf3d::Vector2f& radius, bool reorder = false)
+                    {
+                        sf3d::Vector2i bounds = sf3d::Vector2i(sf3d::Vector2f(std::round(fabsf(radius.x)),std::round(fabsf(radius.y))));
+                        if ((!relativity) && (grid->getTopology() != PLANE))
+                        {
+                            // the stencil can wrap onto itself (or fold over a pole), so distinct offsets may land on the same unit
+                            if ((bounds.x*2+1 >= static_cast<int>(grid->getSize().x)) || (bounds.y*2+1 >= static_cast<int>(grid->getSize().y)) ||
+                                ((grid->getTopology() == SPHERE) && ((static_cast<int>(index.y) < bounds.y) || (static_cast<int>(index.y)+bounds.y >= static_cast<int>(grid->getSize().y)))))
+                            {
+                                findOverlappingOrthogonalComplement(grid,index,radius,reorder);
+                                return;
+                            }
+                        }
+                        const Contents& stencil = getComplementStencil(radius,reorder);
+                        sf3d::Vector2i position;
+                        contents.clear();
+                        contents.reserve(stencil.size());
+                        origin = index;
+                        for (unsigned int i = 0; i != stencil.size(); ++i)
+                        {
+                            position = sf3d::Vector2i(index)+stencil[i];
+                            if ((relativity) || (mapPosition(grid,bounds,position)))
+                            {
+                                contents.push_back(position);
+                            }
+                        }
+                    }
+                    const Contents& getComplementStencil(const sf3d::Vector2f& radius, bool reorder = false)
+                    {
+                        typename StencilMap::iterator iter0 = complements.find(reorder);
+                        if (iter0 != complements.end())
+                        {
+                            typename RadiusLeftMap::iterator iter1 = iter0->second.find(radius.x);
+                            if (iter1 != iter0->second.end())
+                            {
+                                typename RadiusRightMap::iterator iter2 = iter1->second.find(radius.y);
+                                if (iter2 != iter1->second.end())
+                                {
+                                    return iter2->second;
+                                }
+                            }
+                        }
+                        Contents& stencil = complements[reorder][radius.x][radius.y];
+                        sf3d::Vector2i bounds = sf3d::Vector2i(sf3d::Vector2f(std::round(fabsf(radius.x)),std::round(fabsf(radius.y))));
+                        if ((bounds.x == 0) || (bounds.y == 0) || (radius.x != radius.y))
+                        {
+                            return stencil;
+                        }
+                        for (int x = -bounds.x; x != bounds.x+1; ++x)
+                        {
+                            for (int y = -bounds.y; y != bounds.y+1; ++y)
+                            {
+                                if (util::getManhattanDistance(sf3d::Vector2f(static_cast<float>(x),static_cast<float>(y)),sf3d::Vector2f()) >= radius.x+0.5f)
+                                {
+                                    stencil.push_back(sf3d::Vector2i(x,y));
+                                }
+                            }
+                        }
+                        if (reorder)
+                        {
+                            std::stable_sort(stencil.begin(),stencil.end(),[](const sf3d::Vector2i& first, const sf3d::Vector2i& second){
+                                             return (util::getBoundedAngle(util::getDirection(sf3d::Vector2f(),sf3d::Vector2f(first)),false)<util::getBoundedAngle(util::getDirection(sf3d::Vector2f(),sf3d::Vector2f(second)),false));
+                                             });
+                        }
+                        return stencil;
+                    }
+                    const Contents& getStencil(const sf3d::Vector2f& radius)
+                    {
+                        typename StyleStencilMap::iterator iter0 = stencils.find(style);
+                        if (iter0 != stencils.end())
+                        {
+                            typename RadiusLeftMap::iterator iter1 = iter0->second.find(radius.x);
+                            if (iter1 != iter0->second.end())
+                            {
+                                typename RadiusRightMap::iterator iter2 = iter1->second.find(radius.y);
+                                if (iter2 != iter1->second.end())
+                                {
+                                    return iter2->second;
+                                }
+                            }
+                        }
+                        Contents& stencil = stencils[style][radius.x][radius.y];
+                        sf3d::Vector2i bounds = sf3d::Vector2i(sf3d::Vector2f(std::round(fabsf(radius.x)),std::round(fabsf(radius.y))));
+                        if ((bounds.x == 0) || (bounds.y == 0) || ((radius.x != radius.y) && (style != MENAECHMUS)))
+                        {
+                            return stencil;
+                        }
+                        for (int x = -bounds.x; x != bounds.x+1; ++x)
+                        {
+                            for (int y = -bounds.y; y != bounds.y+1; ++y)
+                            {
+                                if (((x != 0) || (y != 0)) && (contains(sf3d::Vector2i(x,y),radius)))
+                                {
+                                    stencil.push_back(sf3d::Vector2i(x,y));
+                                }
+                            }
+                        }
+                        return stencil;
+                    }
+                    bool contains(const sf3d::Vector2i& offset, const sf3d::Vector2f& radius) const
+                    {
+                        switch (style)
+                        {
+                        case MOORE:
+                            return true;
+                        case VON_NEUMANN:
+                            return (util::getManhattanDistance(sf3d::Vector2f(offset),sf3d::Vector2f()) < radius.x+0.5f);
+                        case EUCLID:
+                            return (util::getDistance(sf3d::Vector2f(offset),sf3d::Vector2f()) < radius.x+0.5f);
+                        case MENAECHMUS:
+                            return ((util::sqr(static_cast<float>(offset.x))/util::sqr(radius.x))+(util::sqr(static_cast<float>(offset.y))/util::sqr(radius.y)) < 1.0f);
+                        }
+                        return false;
+                    }
+                    void report(const Grid* grid, bool log = false)
+                    {
+                        Unit* unit = grid->getUnit(origin);
+                        Unit* unitOther;
+                        std::string info;
+                        sf3d::Vector2u index;
+                        info = "\nNeighborhood Size = ";
+                        info += std::to_string(contents.size());
+                        info += "\n";
+                        for (unsigned int i = 0; i != contents.size(); ++i)
+                        {
+                            unitOther = grid->getUnit(this,i);
+                            index = unitOther->getIndex();
+                            info = "\t\n(";
+                            info += std::to_string(origin.x);
+                            info += ",";
+                            info += std::to_string(origin.y);
+                            info += ") -> (";
+                            info += std::to_string(index.x);
+                            info += ",";
+                            info += std::to_string(index.y);
+                            info += "):\n\t\tDistance = ";
+                            info += std::to_string(unit->getDistance(unitOther));
+                            info += "\n\t\tDirection = ";
+                            info += std::to_string(util::getBoundedAngle(unit->getDirection(unitOther),false)*util::RAD_TO_DEG);
+                            info += "\n";
+                        }
+                    }
+                private:
+                    bool mapPosition(const Grid* grid, const sf3d::Vector2i& bounds, sf3d::Vector2i& position) const
+                    {
+                        if ((position.x < 0) || (position.x >= grid->getSize().x) || (position.y < 0) || (position.y >= grid->getSize().y))
+                        {
+                            if ((bounds.x >= static_cast<int>(grid->getSize().x)) || (bounds.y >= static_cast<int>(grid->getSize().y)))
+                            {
+                                position = sf3d::Vector2i(grid->getAbsoluteIndex(position));
+                            }
+                            else
+                            {
+                                switch (grid->getTopology())
+                                {
+                                case TORUS:
+                                    if (position.x < 0)
+                                    {
+                                        position.x += static_cast<int>(grid->getSize().x);
+                                    }
+                                    if (position.x >= static_cast<int>(grid->getSize().x))
+                                    {
+                                        position.x -= static_cast<int>(grid->getSize().x);
+                                    }
+                                    if (position.y < 0)
+                                    {
+                                        position.y += static_cast<int>(grid->getSize().y);
+                                    }
+                                    if (position.y >= static_cast<int>(grid->getSize().y))
+                                    {
+                                        position.y -= static_cast<int>(grid->getSize().y);
+                                    }
+                                    break;
+                                case SPHERE:
+                                    if (position.x < 0)
+                                    {
+                                        position.x += static_cast<int>(grid->getSize().x);
+                                    }
+                                    if (position.x >= static_cast<int>(grid->getSize().x))
+                                    {
+                                        position.x -= static_cast<int>(grid->getSize().x);
+                                    }
+                                    if (position.y < 0)
+                                    {
+                                        position.x = (position.x+(static_cast<int>(grid->getSize().x)/2))%static_cast<int>(grid->getSize().x);
+                                        position.y = 0-(position.y-0);
+                                    }
+                                    if (position.y >= static_cast<int>(grid->getSize().y))
+                                    {
+                                        position.x = (position.x+(static_cast<int>(grid->getSize().x)/2))%static_cast<int>(grid->getSize().x);
+                                        position.y = (static_cast<int>(grid->getSize().y)-1)-(position.y-static_cast<int>(grid->getSize().y));
+                                    }
+                                    break;
+                                case PLANE:
+                                    break;
+                                case QUINCUNCIAL:
+                                    {
+                                        bool horizontal = false;
+                                        bool vertical = false;
+                                        if (position.x < 0)
+                                        {
+                                            position.x = 0-(position.x-0);
+                                            horizontal = true;
+                                        }
+                                        if (position.x >= static_cast<int>(grid->getSize().x))
+                                        {
+                                            position.x = (static_cast<int>(grid->getSize().x)-1)-(position.x-static_cast<int>(grid->getSize().x));
+                                            horizontal = true;
+                                        }
+                                        if (position.y < 0)
+                                        {
+                                            position.y = 0-(position.y-0);
+                                            vertical = true;
+                                        }
+                                        if (position.y >= static_cast<int>(grid->getSize().y))
+                                        {
+                                            position.y = (static_cast<int>(grid->getSize().y)-1)-(position.y-static_cast<int>(grid->getSize().y));
+                                            vertical = true;
+                                        }
+                                        if (horizontal)
+                                        {
+                                            position.x = (static_cast<int>(grid->getSize().x)-1)-position.x;
+                                        }
+                                        if (vertical)
+                                        {
+                                            position.y = (static_cast<int>(grid->getSize().y)-1)-position.y;
+                                        }
+                                    }
+                                    break;
+                                }
+                            }
+                        }
+                        return ((position.x >= 0) && (position.x < grid->getSize().x) && (position.y >= 0) && (position.y < grid->getSize().y));
+                    }
+                    void findOverlappingOrthogonalComplement(const Grid* grid, const sf3d::Vector2u& index, const sf3d::Vector2f& radius, bool reorder)
                     {
                         Style temp = style;
                         style = MOORE;
@@ -586,46 +714,20 @@ namespace NFE
                         }
                         style = temp;
                     }
-                    void report(const Grid* grid, bool log = false)
-                    {
-                        Unit* unit = grid->getUnit(origin);
-                        Unit* unitOther;
-                        std::string info;
-                        sf3d::Vector2u index;
-                        info = "\nNeighborhood Size = ";
-                        info += std::to_string(contents.size());
-                        info += "\n";
-                        for (unsigned int i = 0; i != contents.size(); ++i)
-                        {
-                            unitOther = grid->getUnit(this,i);
-                            index = unitOther->getIndex();
-                            info = "\t\n(";
-                            info += std::to_string(origin.x);
-                            info += ",";
-                            info += std::to_string(origin.y);
-                            info += ") -> (";
-                            info += std::to_string(index.x);
-                            info += ",";
-                            info += std::to_string(index.y);
-                            info += "):\n\t\tDistance = ";
-                            info += std::to_string(unit->getDistance(unitOther));
-                            info += "\n\t\tDirection = ";
-                            info += std::to_string(util::getBoundedAngle(unit->getDirection(unitOther),false)*util::RAD_TO_DEG);
-                            info += "\n";
-                        }
-                    }
-                private:
                     bool relativity;
                     bool cache;
                     Bank* bank;
                     Style style;
                     Contents contents;
+                    StencilMap complements;
+                    StyleStencilMap stencils;
                     sf3d::Vector2u origin;
             };
             typedef typename Neighborhood::Contents Neighbors;
             Grid(const sf3d::Vector2u& size = sf3d::Vector2u(), bool isResponsible = true, Topology topology = TORUS) :
                 isResponsible(isResponsible),
                 topology(topology),
+                capacity(0),
                 units(nullptr)
             {
                 initialize(size);
@@ -640,16 +742,9 @@ namespace NFE
                 {
                     return;
                 }
-                for (unsigned int x = 0; x != size.x; ++x)
-                {
-                    for (unsigned int y = 0; y != size.y; ++y)
-                    {
-                        delete units[x][y];
-                    }
-                    delete[] units[x];
-                }
-                delete[] units;
+                release(units,capacity);
                 units = nullptr;
+                capacity = 0;
                 size = sf3d::Vector2u();
             }
             void initialize(const sf3d::Vector2u& size)
@@ -660,28 +755,12 @@ namespace NFE
                     units = nullptr;
                     return;
                 }
-                units = new Unit**[size.x];
-                for (unsigned int x = 0; x != size.x; ++x)
-                {
-                    units[x] = new Unit*[size.y];
-                    for (unsigned int y = 0; y != size.y; ++y)
-                    {
-                        units[x][y] = nullptr;
-                    }
-                }
                 this->size = size;
+                allocate();
             }
             void setUnit(T unit, const sf3d::Vector2u& index)
             {
-                Unit* temp = units[index.x][index.y];
-                if (temp == nullptr)
-                {
-                    units[index.x][index.y] = new Unit(this,index,unit);
-                }
-                else
-                {
-                    temp->setPayload(unit);
-                }
+                units[getOffset(index)].setPayload(unit);
             }
             Unit* getUnit(Neighborhood* neighborhood, unsigned int index) const
             {
@@ -691,9 +770,29 @@ namespace NFE
                 }
                 return getUnit(sf3d::Vector2u(neighborhood->getContents()[index]));
             }
+            // A unit that was never given a payload reads as absent.
             Unit* getUnit(const sf3d::Vector2u& index) const
             {
-                return units[index.x][index.y];
+                Unit* unit = &units[getOffset(index)];
+                if (unit->getPayload() == T())
+                {
+                    return nullptr;
+                }
+                return unit;
+            }
+            unsigned int getOffset(const sf3d::Vector2u& index) const
+            {
+                return (index.x*size.y)+index.y;
+            }
+            bool getIndex(unsigned int offset, sf3d::Vector2u& index) const
+            {
+                index.x = offset/size.y;
+                index.y = offset%size.y;
+                return true;
+            }
+            unsigned int getCapacity() const
+            {
+                return capacity;
             }
             const sf3d::Vector2u& getSize() const
             {
@@ -711,7 +810,7 @@ namespace NFE
                 {
                     for (unsigned int y = 0; y != size.y; ++y)
                     {
-                        image->setPixel(x,y,conversion(units[x][y]));
+                        image->setPixel(x,y,conversion(getUnit(sf3d::Vector2u(x,y))));
                     }
                 }
                 return image;
@@ -842,10 +941,31 @@ namespace NFE
             }
             typedef Unit Container;
         private:
+            // Units are stored by value in storage order, so walking offsets walks memory.
+            void allocate()
+            {
+                sf3d::Vector2u index;
+                capacity = size.x*size.y;
+                units = static_cast<Unit*>(::operator new(capacity*sizeof(Unit)));
+                for (unsigned int i = 0; i != capacity; ++i)
+                {
+                    getIndex(i,index);
+                    new (&units[i]) Unit(this,index,T());
+                }
+            }
+            static void release(Unit* units, unsigned int capacity)
+            {
+                for (unsigned int i = 0; i != capacity; ++i)
+                {
+                    units[i].~Unit();
+                }
+                ::operator delete(units);
+            }
             bool isResponsible;
             sf3d::Vector2u size;
             Topology topology;
-            Unit*** units;
+            unsigned int capacity;
+            Unit* units;
     };
 }
 
@@ -0,0 +1,54 @@
+#ifndef NFE_JOB_SYSTEM_HPP
+#define NFE_JOB_SYSTEM_HPP
+
+#include <NFE/Repository.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NFE
+{
+    // A fixed pool of worker threads taking jobs in submission order, so that automaton work can leave the render thread.
+    // The result of a job is handed back through a future, which a game loop polls once per frame with isReady().
+    class JobSystem
+    {
+        public:
+            JobSystem(unsigned int workers = 0);
+            virtual ~JobSystem();
+            template <class Function>
+            auto submit(Function function) -> std::future<decltype(function())>
+            {
+                typedef decltype(function()) Result;
+                // packaged_task cannot be copied into a std::function, so it is shared instead
+                std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(function);
+                std::future<Result> future = task->get_future();
+                execute([task](){(*task)();});
+                return future;
+            }
+            void execute(const std::function<void()>& job);
+            RepositoryExecutor getExecutor();
+            unsigned int getWorkerCount() const;
+            unsigned int getPendingCount() const;
+            template <class Type>
+            static bool isReady(const std::future<Type>& future)
+            {
+                return ((future.valid()) && (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready));
+            }
+            static JobSystem* getInstance();
+        private:
+            void work();
+            mutable std::mutex mutex;
+            std::condition_variable condition;
+            std::deque<std::function<void()>> jobs;
+            std::vector<std::thread> workers;
+            bool stopping;
+    };
+}
+
+#endif // NFE_JOB_SYSTEM_HPP
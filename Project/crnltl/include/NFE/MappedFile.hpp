@@ -0,0 +1,50 @@
+#ifndef NFE_MAPPED_FILE_HPP
+#define NFE_MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace NFE
+{
+    // A file mapped into memory in its entirety, read-only or shared read-write.
+    class MappedFile
+    {
+        public:
+            enum Advice
+            {
+                NORMAL,
+                SEQUENTIAL,
+                RANDOM,
+                WILL_NEED,
+                DONT_NEED
+            };
+            MappedFile();
+            virtual ~MappedFile();
+            bool create(const std::string& path, std::uint64_t size);
+            bool open(const std::string& path, bool writable = false);
+            void close();
+            // grows or shrinks a writable mapping along with its file, which may move the data
+            bool resize(std::uint64_t size);
+            bool flush(std::uint64_t offset = 0, std::uint64_t length = 0);
+            void advise(std::uint64_t offset, std::uint64_t length, Advice advice) const;
+            bool isOpen() const;
+            bool isWritable() const;
+            std::uint64_t getSize() const;
+            unsigned char* getData() const;
+        private:
+            MappedFile(const MappedFile& other) = delete;
+            MappedFile& operator=(const MappedFile& other) = delete;
+            bool map(const std::string& path, std::uint64_t size, bool writable, bool truncate);
+            unsigned char* data;
+            std::uint64_t size;
+            bool writable;
+#ifdef _WIN32
+            void* file;
+            void* mapping;
+#else
+            int descriptor;
+#endif
+    };
+}
+
+#endif // NFE_MAPPED_FILE_HPP
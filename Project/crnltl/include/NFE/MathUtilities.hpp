@@ -4,6 +4,7 @@
 #include <SFML3D/System/Vector2.hpp>
 #include <SFML3D/System/Vector3.hpp>
 #include <vector>
+#include <cstdint>
 #include <complex>
 #include <cmath>
 
@@ -45,6 +46,8 @@ namespace NFE
         unsigned int hashFinalMixAlt(unsigned int a, unsigned int b, unsigned int c);
         unsigned int hashString(const std::string& str, unsigned int seed = 0);
         unsigned int hashInts(const std::vector<unsigned int>& ints, unsigned int seed = 0);
+        std::uint64_t hashMix64(std::uint64_t x);
+        std::uint64_t hashInts64(const std::vector<unsigned int>& ints, std::uint64_t seed = 0);
         float clamp(float front, float back, float value);
         float mix(float val1, float val2, float key);
         sf3d::Vector2f mix(const sf3d::Vector2f& vec1, const sf3d::Vector2f& vec2, float key);
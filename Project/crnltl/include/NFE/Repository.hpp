@@ -11,10 +11,17 @@ Original source code has been altered.
 #ifndef NFE_REPOSITORY_HPP
 #define NFE_REPOSITORY_HPP
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <tuple>
 #include <vector>
 #include <functional>
 
@@ -22,15 +29,249 @@ namespace NFE
 {
     struct DefaultRepositorySlotKey;
 
+    // Epoch based reclamation for the slot values.
+    // A reader publishes the global epoch it entered at, and a replaced value is only freed
+    // once every active reader entered after the value was retired. Reads take no lock and touch
+    // no shared refcount, while writers, which are expected to be rare, serialize on a mutex.
+    // There is one epoch domain for the whole process: a pin held for long keeps every repository
+    // from freeing what it replaced since, so long lived readers should copy the shared_ptr instead.
+    class RepositoryEpoch
+    {
+        public:
+            static void retire(const std::function<void()>& deleter)
+            {
+                State& state = getState();
+                std::vector<Retired> ready;
+                {
+                    std::lock_guard<std::mutex> l(state.mutex);
+                    state.retired.push_back(Retired{state.epoch.fetch_add(1), deleter});
+                    collect(state, ready);
+                }
+                for (auto& retired : ready)
+                {
+                    retired.deleter();
+                }
+            }
+
+            static void collect()
+            {
+                State& state = getState();
+                std::vector<Retired> ready;
+                {
+                    std::lock_guard<std::mutex> l(state.mutex);
+                    collect(state, ready);
+                }
+                for (auto& retired : ready)
+                {
+                    retired.deleter();
+                }
+            }
+
+        private:
+            friend class RepositoryPin;
+
+            struct Reader
+            {
+                std::atomic<std::uint64_t> epoch;
+                std::atomic_bool used;
+                Reader* next;
+                std::atomic<unsigned int> depth;
+            };
+
+            // Returns the record to hand back to leave(), which may then happen on any thread.
+            static Reader* enter()
+            {
+                Reader* reader = getReader();
+                if (reader->depth.fetch_add(1) == 0)
+                {
+                    reader->epoch.store(getState().epoch.load());
+                }
+                return reader;
+            }
+
+            static void leave(Reader* reader)
+            {
+                // the epoch is left as is, a reader only counts while its depth is not zero
+                reader->depth.fetch_sub(1, std::memory_order_release);
+            }
+
+            struct Retired
+            {
+                std::uint64_t epoch;
+                std::function<void()> deleter;
+            };
+
+            struct State
+            {
+                State():
+                        epoch(1),
+                        readers(nullptr)
+                {
+                }
+
+                std::atomic<std::uint64_t> epoch;
+                std::atomic<Reader*> readers;
+                std::mutex mutex;
+                std::vector<Retired> retired;
+            };
+
+            struct Registration
+            {
+                Registration():
+                        reader(acquire())
+                {
+                }
+
+                ~Registration()
+                {
+                    reader->used.store(false, std::memory_order_release);
+                }
+
+                Reader* reader;
+            };
+
+            static State& getState()
+            {
+                // Never destroyed, so that values retired during static destruction are still safe.
+                static State* state = new State();
+                return *state;
+            }
+
+            static Reader* getReader()
+            {
+                static thread_local Registration registration;
+                return registration.reader;
+            }
+
+            static Reader* acquire()
+            {
+                // Records of threads that have exited are reused, so the list only grows with the peak thread count.
+                // Their depth is kept, as a pin moved off the thread may still be holding it.
+                State& state = getState();
+                for (Reader* reader = state.readers.load(std::memory_order_acquire); reader != nullptr; reader = reader->next)
+                {
+                    bool expected = false;
+                    if ((!reader->used.load()) && (reader->used.compare_exchange_strong(expected, true)))
+                    {
+                        return reader;
+                    }
+                }
+                Reader* reader = new Reader();
+                reader->epoch.store(0);
+                reader->used.store(true);
+                reader->depth.store(0);
+                reader->next = state.readers.load();
+                while (!state.readers.compare_exchange_weak(reader->next, reader))
+                {
+                }
+                return reader;
+            }
+
+            static void collect(State& state, std::vector<Retired>& ready)
+            {
+                std::uint64_t minimum = std::numeric_limits<std::uint64_t>::max();
+                for (Reader* reader = state.readers.load(std::memory_order_acquire); reader != nullptr; reader = reader->next)
+                {
+                    // a reader seen between raising its depth and storing its epoch still shows an older epoch, which only delays frees
+                    if (reader->depth.load() == 0)
+                    {
+                        continue;
+                    }
+                    std::uint64_t epoch = reader->epoch.load();
+                    if (epoch < minimum)
+                    {
+                        minimum = epoch;
+                    }
+                }
+                auto iter = std::partition(state.retired.begin(), state.retired.end(), [minimum](const Retired& retired) {
+                    return (retired.epoch >= minimum);});
+                std::move(iter, state.retired.end(), std::back_inserter(ready));
+                state.retired.erase(iter, state.retired.end());
+            }
+    };
+
+    // Keeps the calling thread inside an epoch for as long as it lives, so borrowed slot values stay valid.
+    // It releases the reader it entered with, so it may be moved to and destroyed on another thread.
+    class RepositoryPin
+    {
+        public:
+            RepositoryPin():
+                    reader_(RepositoryEpoch::enter())
+            {
+            }
+
+            RepositoryPin(RepositoryPin&& other):
+                    reader_(other.reader_)
+            {
+                other.reader_ = nullptr;
+            }
+
+            RepositoryPin(const RepositoryPin&) = delete;
+
+            RepositoryPin & operator=(const RepositoryPin&) = delete;
+
+            ~RepositoryPin()
+            {
+                if (reader_ != nullptr)
+                {
+                    RepositoryEpoch::leave(reader_);
+                }
+            }
+
+        private:
+            RepositoryEpoch::Reader* reader_;
+    };
+
+    // A borrowed reference to a slot value, valid while it lives, without touching the shared_ptr refcount.
+    // Meant for short reads: while it lives no repository frees a replaced value, see RepositoryEpoch.
+    template <class Type>
+    class RepositoryReference
+    {
+        public:
+            RepositoryReference(RepositoryPin&& pin, Type* value):
+                    pin_(std::move(pin)),
+                    value_(value)
+            {
+            }
+
+            RepositoryReference(RepositoryReference&& other) = default;
+
+            Type* get() const
+            {
+                return value_;
+            }
+
+            Type& operator*() const
+            {
+                return *value_;
+            }
+
+            Type* operator->() const
+            {
+                return value_;
+            }
+
+        private:
+            RepositoryPin pin_;
+            Type* value_;
+    };
+
     template <class Type, class Key = DefaultRepositorySlotKey> class RepositorySlot;
 
+    // Runs a notification task, for example by queueing it on a thread pool. An empty executor runs it inline.
+    using RepositoryExecutor = std::function<void(std::function<void()>)>;
+
     template <class Type, class Key>
     class Watcher
     {
         public:
+            using Callback = std::function<void(const std::shared_ptr<Type>&)>;
+
             Watcher(RepositorySlot<Type, Key>& RepositorySlot):
                     RepositorySlot_(RepositorySlot),
-                    hasBeenChanged_(false)
+                    hasBeenChanged_(false),
+                    version_(RepositorySlot.doGetVersion()),
+                    dispatch_(std::make_shared<Dispatch>(this))
             {
             }
 
@@ -38,14 +279,81 @@ namespace NFE
 
             Watcher & operator=(const Watcher&) = delete;
 
+            ~Watcher()
+            {
+                disarm();
+            }
+
             bool hasBeenChanged() const
             {
                 return hasBeenChanged_;
             }
 
+            // True when the slot was set after the last get(), without touching the watcher state.
+            bool isStale() const
+            {
+                return (RepositorySlot_.doGetVersion() != version_);
+            }
+
+            std::uint64_t getVersion() const
+            {
+                return version_;
+            }
+
             void triggerChanges()
             {
-                hasBeenChanged_ = true;
+                {
+                    std::lock_guard<std::mutex> l(mutex_);
+                    hasBeenChanged_ = true;
+                }
+                condition_.notify_all();
+                if ((dispatch_->armed) && (!dispatch_->pending.exchange(true)))
+                {
+                    // Sets arriving before the task runs are coalesced into it, since it reads the latest value.
+                    std::shared_ptr<Dispatch> dispatch = dispatch_;
+                    std::function<void()> task = [dispatch]() {
+                        std::lock_guard<std::mutex> l(dispatch->mutex);
+                        dispatch->pending = false;
+                        if (dispatch->watcher != nullptr)
+                        {
+                            // Reads the slot directly, so the callback does not consume the change that wait() and hasBeenChanged() report.
+                            dispatch->callback(dispatch->watcher->RepositorySlot_.doGet());
+                        }};
+                    if (dispatch_->executor)
+                    {
+                        dispatch_->executor(task);
+                    }
+                    else
+                    {
+                        task();
+                    }
+                }
+            }
+
+            // Blocks until the slot is set or the timeout expires, and returns whether it was set.
+            template <class Rep, class Period>
+            bool wait(const std::chrono::duration<Rep, Period>& timeout)
+            {
+                std::unique_lock<std::mutex> l(mutex_);
+                return condition_.wait_for(l, timeout, [this]() {
+                    return hasBeenChanged_.load();});
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> l(mutex_);
+                condition_.wait(l, [this]() {
+                    return hasBeenChanged_.load();});
+            }
+
+            // Calls back with the new value after each burst of sets, on the executor if one is given.
+            // The callback is set up once, before the slot can change concurrently, and must not set the slot it watches.
+            void setCallback(const Callback& callback, const RepositoryExecutor& executor = RepositoryExecutor())
+            {
+                std::lock_guard<std::mutex> l(dispatch_->mutex);
+                dispatch_->callback = callback;
+                dispatch_->executor = executor;
+                dispatch_->armed = static_cast<bool>(callback);
             }
 
             auto get() -> decltype(std::declval<RepositorySlot<Type, Key>>().doGet())
@@ -53,12 +361,43 @@ namespace NFE
                 hasBeenChanged_ = false; // Note: even if there is an update of the value between this line and the getValue one,
                 // we will still have the latest version.
                 // Note 2: atomic_bool automatically use a barrier and the two operations can't be inversed.
+                version_ = RepositorySlot_.doGetVersion();
                 return RepositorySlot_.doGet();
             }
 
         private:
+            friend class RepositorySlot<Type, Key>;
+
+            // Waits for a callback that is running right now, and disarms any that are still queued.
+            void disarm()
+            {
+                std::lock_guard<std::mutex> l(dispatch_->mutex);
+                dispatch_->watcher = nullptr;
+            }
+
+            struct Dispatch
+            {
+                Dispatch(Watcher* watcher):
+                        watcher(watcher),
+                        armed(false),
+                        pending(false)
+                {
+                }
+
+                std::mutex mutex;
+                Watcher* watcher;
+                Callback callback;
+                RepositoryExecutor executor;
+                std::atomic_bool armed;
+                std::atomic_bool pending;
+            };
+
             RepositorySlot<Type, Key>& RepositorySlot_;
             std::atomic_bool hasBeenChanged_;
+            std::atomic<std::uint64_t> version_;
+            std::mutex mutex_;
+            std::condition_variable condition_;
+            std::shared_ptr<Dispatch> dispatch_;
     };
 
 
@@ -71,65 +410,165 @@ namespace NFE
     {
         public:
             using ThisType = RepositorySlot<Type, Key>;
+            using ValueType = Type;
+            using KeyType = Key;
             using WatcherType = Watcher<Type, Key>;
             using WatcherTypePtr = std::unique_ptr<WatcherType, std::function<void(WatcherType*)>>;
+            using WatcherList = std::vector<std::shared_ptr<WatcherType>>;
 
         public:
+            RepositorySlot():
+                    watchers_(std::make_shared<const WatcherList>()),
+                    node_(new Node()),
+                    version_(0),
+                    watcher_count_(0)
+            {
+            }
+
+            RepositorySlot(const RepositorySlot&) = delete;
+
+            RepositorySlot & operator=(const RepositorySlot&) = delete;
+
+            ~RepositorySlot()
+            {
+                delete node_.load();
+            }
+
             std::shared_ptr<Type> doGet() const
             {
-                return std::atomic_load(&value_);
+                RepositoryPin pin;
+                return node_.load()->value;
+            }
+
+            RepositoryReference<Type> doRead() const
+            {
+                RepositoryPin pin;
+                Type* value = node_.load()->value.get();
+                return RepositoryReference<Type>(std::move(pin), value);
+            }
+
+            // Only valid while the calling thread holds a RepositoryPin.
+            Type* doPeek() const
+            {
+                return node_.load()->value.get();
             }
 
             void doSet(const std::shared_ptr<Type> &value)
             {
-                std::atomic_exchange(&value_, value);
+                Node* old = node_.exchange(new Node{value});
+                ++version_;
+                RepositoryEpoch::retire([old]() {
+                    delete old;});
                 signal();
             }
 
+            // Increases by one with every set, so a stale copy can be detected by comparing two integers.
+            std::uint64_t doGetVersion() const
+            {
+                return version_.load();
+            }
+
+            // Lets a writer skip producing values nobody watches, without taking the watchers mutex.
+            std::size_t doGetWatcherCount() const
+            {
+                return watcher_count_.load();
+            }
+
             WatcherTypePtr doGetWatcher()
             {
-                WatcherTypePtr watcher(new WatcherType(*this), [this](WatcherType* toBeDelete) {
+                // The list shares ownership, so a signal() that picked the watcher up before it was unregistered can still finish with it.
+                std::shared_ptr<WatcherType> shared(new WatcherType(*this));
+                WatcherTypePtr watcher(shared.get(), [this, shared](WatcherType* toBeDelete) {
                     this->unregisterWatcher(toBeDelete);});
 
-                registerWatcher(watcher.get());
+                registerWatcher(shared);
 
                 return watcher;
             }
 
         private:
-            void registerWatcher(WatcherType* newWatcher)
+            void registerWatcher(const std::shared_ptr<WatcherType>& newWatcher)
             {
                 std::lock_guard<std::mutex> l(watchers_mutex_);
-                watchers_.push_back(newWatcher);
+                std::shared_ptr<WatcherList> watchers = std::make_shared<WatcherList>(*std::atomic_load(&watchers_));
+                watchers->push_back(newWatcher);
+                watcher_count_.store(watchers->size());
+                std::atomic_store(&watchers_, std::shared_ptr<const WatcherList>(std::move(watchers)));
             }
 
             void unregisterWatcher(WatcherType *toBeDelete)
             {
-                std::lock_guard<std::mutex> l(watchers_mutex_);
-                watchers_.erase(std::remove(watchers_.begin(), watchers_.end(), toBeDelete), watchers_.end());
+                {
+                    std::lock_guard<std::mutex> l(watchers_mutex_);
+                    std::shared_ptr<WatcherList> watchers = std::make_shared<WatcherList>(*std::atomic_load(&watchers_));
+                    watchers->erase(std::remove_if(watchers->begin(), watchers->end(), [toBeDelete](const std::shared_ptr<WatcherType>& watcher) {
+                        return (watcher.get() == toBeDelete);}), watchers->end());
+                    watcher_count_.store(watchers->size());
+                    std::atomic_store(&watchers_, std::shared_ptr<const WatcherList>(std::move(watchers)));
+                }
 
-                delete toBeDelete;
+                // A signal() still holding the old list may touch the watcher, but can no longer call back through it.
+                toBeDelete->disarm();
             }
 
+            // Notifies a snapshot of the watchers, so sets never wait on registrations or on each other.
             void signal()
             {
-                std::lock_guard<std::mutex> l(watchers_mutex_);
-                for (auto watcher : watchers_)
+                std::shared_ptr<const WatcherList> watchers = std::atomic_load(&watchers_);
+                for (const auto& watcher : *watchers)
                 {
                     watcher->triggerChanges();
                 }
             }
 
         private:
-            std::vector<WatcherType*> watchers_;
-            std::shared_ptr<Type> value_;
+            struct Node
+            {
+                std::shared_ptr<Type> value;
+            };
+
+            std::shared_ptr<const WatcherList> watchers_;
+            std::atomic<Node*> node_;
+            std::atomic<std::uint64_t> version_;
+            std::atomic<std::size_t> watcher_count_;
             std::mutex watchers_mutex_;
     };
 
+    template <class Slot>
+    struct RepositorySnapshotEntry
+    {
+        typename Slot::ValueType* value;
+    };
+
+    // Borrowed references to every slot of a repository, taken together so that no set was in flight in between.
+    template <class... RepositorySlots>
+    class RepositorySnapshot
+    {
+        public:
+            template <class Type, class Key = DefaultRepositorySlotKey>
+            Type* get() const
+            {
+                return std::get<RepositorySnapshotEntry<RepositorySlot<Type, Key>>>(entries_).value;
+            }
+
+        private:
+            template <class... Slots>
+            friend class Repository;
+
+            RepositoryPin pin_;
+            std::tuple<RepositorySnapshotEntry<RepositorySlots>...> entries_;
+    };
+
     template<class... RepositorySlots>
     class Repository : private RepositorySlots...
     {
         public:
+            Repository():
+                    started_(0),
+                    finished_(0)
+            {
+            }
+
             template <class Type, class Key = DefaultRepositorySlotKey>
             std::shared_ptr<Type> get()
             {
@@ -138,12 +577,43 @@ namespace NFE
                 return RepositorySlot<Type, Key>::doGet();
             }
 
+            template <class Type, class Key = DefaultRepositorySlotKey>
+            RepositoryReference<Type> read() const
+            {
+                static_assert(std::is_base_of<RepositorySlot<Type, Key>, Repository<RepositorySlots...>>::value,
+                              "Please ensure that this type or this key exists in this repository");
+                return RepositorySlot<Type, Key>::doRead();
+            }
+
+            template <class Type, class Key = DefaultRepositorySlotKey>
+            std::uint64_t getVersion() const
+            {
+                static_assert(std::is_base_of<RepositorySlot<Type, Key>, Repository<RepositorySlots...>>::value,
+                              "Please ensure that this type or this key exists in this repository");
+                return RepositorySlot<Type, Key>::doGetVersion();
+            }
+
+            RepositorySnapshot<RepositorySlots...> snapshot() const
+            {
+                RepositorySnapshot<RepositorySlots...> result;
+                std::uint64_t finished;
+                do
+                {
+                    finished = finished_.load();
+                    result.entries_ = std::make_tuple(RepositorySnapshotEntry<RepositorySlots>{RepositorySlots::doPeek()}...);
+                }
+                while (started_.load() != finished);
+                return result;
+            }
+
             template <class Type, class Key = DefaultRepositorySlotKey>
             void set(const std::shared_ptr<Type>& value)
             {
                 static_assert(std::is_base_of<RepositorySlot<Type, Key>, Repository<RepositorySlots...>>::value,
                               "Please ensure that this type or this key exists in this repository");
+                ++started_;
                 RepositorySlot<Type, Key>::doSet(value);
+                ++finished_;
             }
 
             template <class Type, class Key = DefaultRepositorySlotKey, class ...Args>
@@ -151,7 +621,17 @@ namespace NFE
             {
                 static_assert(std::is_base_of<RepositorySlot<Type, Key>, Repository<RepositorySlots...>>::value,
                               "Please ensure that this type or this key exists in this repository");
+                ++started_;
                 RepositorySlot<Type, Key>::doSet(std::make_shared<Type>(std::forward<Args>(args)...));
+                ++finished_;
+            }
+
+            template <class Type, class Key = DefaultRepositorySlotKey>
+            std::size_t getWatcherCount() const
+            {
+                static_assert(std::is_base_of<RepositorySlot<Type, Key>, Repository<RepositorySlots...>>::value,
+                              "Please ensure that this type or this key exists in this repository");
+                return RepositorySlot<Type, Key>::doGetWatcherCount();
             }
 
             template <class Type, class Key = DefaultRepositorySlotKey>
@@ -161,6 +641,10 @@ namespace NFE
                               "Please ensure that this type or this key exists in this repository");
                 return RepositorySlot<Type, Key>::doGetWatcher();
             }
+
+        private:
+            std::atomic<std::uint64_t> started_;
+            std::atomic<std::uint64_t> finished_;
     };
 
 }
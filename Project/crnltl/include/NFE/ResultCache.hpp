@@ -0,0 +1,73 @@
+#ifndef NFE_RESULT_CACHE_HPP
+#define NFE_RESULT_CACHE_HPP
+
+#include <NFE/CellularAutomaton.hpp>
+#include <SFML3D/Graphics/Image.hpp>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace NFE
+{
+    // A process wide cache of finished runs of seeded automata.
+    // A run is made by a factory from a size and a Random of the given seed, then advanced for a number of generations,
+    // so the same key always yields the same board. Transitions are code and cannot be hashed, so the factory name
+    // stands for them and the rules hash has to cover any further parameter the factory was given (0 when there is none).
+    // When a directory is set, finished boards are also kept there as cell files and read back on a miss in memory.
+    class ResultCache
+    {
+        public:
+            typedef CellularAutomaton* (*Factory)(const sf3d::Vector2u&, Random*);
+            struct Key
+            {
+                std::string factory;
+                sf3d::Vector2u size;
+                unsigned int seed;
+                unsigned int generations;
+                std::uint64_t rules;
+                bool operator<(const Key& other) const;
+            };
+            class Result
+            {
+                public:
+                    Result(const ArrayBoard& board);
+                    const ArrayBoard& getBoard() const;
+                    const sf3d::Image& getImage(bool life = true) const;
+                private:
+                    ArrayBoard board;
+                    sf3d::Image image;
+                    sf3d::Image lifeImage;
+            };
+            ResultCache(unsigned int capacity = 64);
+            virtual ~ResultCache();
+            std::shared_ptr<const Result> get(const Key& key);
+            std::shared_ptr<const Result> put(const Key& key, const CellularAutomaton* automaton);
+            std::shared_ptr<const Result> run(const std::string& factoryName, Factory factory, const sf3d::Vector2u& size, unsigned int seed, unsigned int generations, std::uint64_t rules = 0);
+            void setDirectory(const std::string& directory);
+            std::string getDirectory() const;
+            void setCapacity(unsigned int capacity);
+            unsigned int getCapacity() const;
+            unsigned int getCount() const;
+            void clear();
+            static ResultCache* getInstance();
+        private:
+            typedef std::pair<Key,std::shared_ptr<const Result>> Entry;
+            typedef std::list<Entry> Entries;
+            void insert(const Key& key, std::shared_ptr<const Result> result);
+            void trim();
+            std::shared_ptr<const Result> load(const std::string& directory, const Key& key) const;
+            bool store(const std::string& directory, const Key& key, const Result& result) const;
+            static std::string getPath(const std::string& directory, const Key& key);
+            mutable std::mutex mutex;
+            // the most recently used entry first
+            Entries entries;
+            std::map<Key,Entries::iterator> index;
+            std::string directory;
+            unsigned int capacity;
+    };
+}
+
+#endif // NFE_RESULT_CACHE_HPP
@@ -0,0 +1,48 @@
+#ifndef NFE_SPARSE_CELLULAR_AUTOMATON_HPP
+#define NFE_SPARSE_CELLULAR_AUTOMATON_HPP
+
+#include <NFE/CellularAutomaton.hpp>
+#include <NFE/SparseGrid.hpp>
+
+namespace NFE
+{
+    // An unbounded PLANE automaton that only stores 64x64 chunks holding a non-zero state.
+    // Each generation steps the live chunks plus the ring of chunks their neighborhoods can reach,
+    // and chunks that end up all zero are released. Absent cells read as Cell(0,0), so the rules
+    // must map a cell of state 0 with no live neighbors back to state 0. Generations are computed
+    // synchronously, with lives following the STATE_LIFE_RULE as CellularAutomaton::update does.
+    class SparseCellularAutomaton
+    {
+        public:
+            typedef CellularAutomaton::Cell Cell;
+            typedef SparseGrid<Cell> Cells;
+            typedef CellularAutomaton::Rules Rules;
+            typedef CellularAutomaton::Neighbors Neighbors;
+            SparseCellularAutomaton();
+            SparseCellularAutomaton(const CellularAutomaton& prototype);
+            virtual ~SparseCellularAutomaton();
+            void goToNextGeneration();
+            void setState(const sf3d::Vector2i& position, unsigned int state);
+            unsigned int getState(const sf3d::Vector2i& position) const;
+            unsigned int getGenerationCount() const;
+            unsigned int getChunkCount() const;
+            unsigned int getCellsOfStateCount(unsigned int state) const;
+            const Cells* getCells() const;
+            Rules* getRules() const;
+            sf3d::Image* getImage(const sf3d::Vector2i& origin, const sf3d::Vector2u& size, bool life = true) const;
+            static SparseCellularAutomaton* getConwayGameOfLife(const sf3d::Vector2u& size, Random* random = nullptr);
+        private:
+            typedef std::vector<const Cells::Chunk*> Window;
+            void adopt(const CellularAutomaton& prototype);
+            static int getReach(const CellularAutomaton::NeighborhoodRadius& radius);
+            void getNeighbors(const Cell& cell, int x, int y, const Window& window, int reach, const CellularAutomaton::NeighborhoodRadius& radius, const CellularAutomaton::Neighborhoods& neighborhoods, Neighbors& neighbors);
+            unsigned int generationCount;
+            Rules* rules;
+            Cells* cells;
+            // The grid the next generation is written into, and the chunks the last one left behind.
+            Cells* generation;
+            std::vector<Cells::Chunk*> spare;
+    };
+}
+
+#endif // NFE_SPARSE_CELLULAR_AUTOMATON_HPP
@@ -0,0 +1,210 @@
+#ifndef NFE_SPARSE_GRID_HPP
+#define NFE_SPARSE_GRID_HPP
+
+#include <SFML3D/System/Vector2.hpp>
+#include <functional>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+namespace NFE
+{
+    template <class T>
+    class SparseGrid
+    {
+        public:
+            static const int CHUNK_SIZE = 64;
+            typedef std::pair<int,int> ChunkIndex;
+            struct ChunkHash
+            {
+                std::size_t operator()(const ChunkIndex& index) const
+                {
+                    return (static_cast<std::size_t>(static_cast<unsigned int>(index.first))*0x9E3779B1u)^static_cast<unsigned int>(index.second);
+                }
+            };
+            class Chunk
+            {
+                public:
+                    Chunk(const ChunkIndex& index, const T& fill) :
+                        index(index),
+                        units(CHUNK_SIZE*CHUNK_SIZE,fill)
+                    {
+
+                    }
+                    virtual ~Chunk()
+                    {
+                        units.clear();
+                    }
+                    const ChunkIndex& getIndex() const
+                    {
+                        return index;
+                    }
+                    // Moves a recycled chunk, leaving its units to be overwritten by the caller.
+                    void setIndex(const ChunkIndex& index)
+                    {
+                        this->index = index;
+                    }
+                    sf3d::Vector2i getOrigin() const
+                    {
+                        return sf3d::Vector2i(index.first*CHUNK_SIZE,index.second*CHUNK_SIZE);
+                    }
+                    T& getUnit(int x, int y)
+                    {
+                        return units[(x*CHUNK_SIZE)+y];
+                    }
+                    const T& getUnit(int x, int y) const
+                    {
+                        return units[(x*CHUNK_SIZE)+y];
+                    }
+                    bool isQuiet(std::function<bool(const T&)> quiet) const
+                    {
+                        for (unsigned int i = 0; i != units.size(); ++i)
+                        {
+                            if (!quiet(units[i]))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    }
+                private:
+                    ChunkIndex index;
+                    std::vector<T> units;
+            };
+            typedef std::unordered_map<ChunkIndex,Chunk*,ChunkHash> Chunks;
+            SparseGrid(const T& fill = T()) :
+                fill(fill)
+            {
+
+            }
+            SparseGrid(const SparseGrid&) = delete;
+            SparseGrid& operator=(const SparseGrid&) = delete;
+            virtual ~SparseGrid()
+            {
+                clear();
+            }
+            void clear()
+            {
+                for (typename Chunks::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+                {
+                    delete iter->second;
+                }
+                chunks.clear();
+            }
+            // Empties the grid like clear(), but hands the chunks over instead of deleting them.
+            void recycle(std::vector<Chunk*>& spare)
+            {
+                for (typename Chunks::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+                {
+                    spare.push_back(iter->second);
+                }
+                chunks.clear();
+            }
+            const T& getUnit(const sf3d::Vector2i& position) const
+            {
+                typename Chunks::const_iterator iter = chunks.find(getChunkIndex(position));
+                if (iter == chunks.end())
+                {
+                    return fill;
+                }
+                return iter->second->getUnit(getLocal(position.x),getLocal(position.y));
+            }
+            void setUnit(const T& unit, const sf3d::Vector2i& position)
+            {
+                getChunk(getChunkIndex(position),true)->getUnit(getLocal(position.x),getLocal(position.y)) = unit;
+            }
+            Chunk* getChunk(const ChunkIndex& index, bool create = false)
+            {
+                typename Chunks::iterator iter = chunks.find(index);
+                if (iter != chunks.end())
+                {
+                    return iter->second;
+                }
+                if (!create)
+                {
+                    return nullptr;
+                }
+                Chunk* chunk = new Chunk(index,fill);
+                chunks[index] = chunk;
+                return chunk;
+            }
+            const Chunk* getChunk(const ChunkIndex& index) const
+            {
+                typename Chunks::const_iterator iter = chunks.find(index);
+                if (iter != chunks.end())
+                {
+                    return iter->second;
+                }
+                return nullptr;
+            }
+            void insertChunk(Chunk* chunk)
+            {
+                typename Chunks::iterator iter = chunks.find(chunk->getIndex());
+                if (iter != chunks.end())
+                {
+                    delete iter->second;
+                    iter->second = chunk;
+                    return;
+                }
+                chunks[chunk->getIndex()] = chunk;
+            }
+            unsigned int release(std::function<bool(const T&)> quiet)
+            {
+                unsigned int count = 0;
+                typename Chunks::iterator iter = chunks.begin();
+                while (iter != chunks.end())
+                {
+                    if (iter->second->isQuiet(quiet))
+                    {
+                        delete iter->second;
+                        iter = chunks.erase(iter);
+                        ++count;
+                    }
+                    else
+                    {
+                        ++iter;
+                    }
+                }
+                return count;
+            }
+            const Chunks& getChunks() const
+            {
+                return chunks;
+            }
+            unsigned int getChunkCount() const
+            {
+                return chunks.size();
+            }
+            const T& getFill() const
+            {
+                return fill;
+            }
+            void swap(SparseGrid& other)
+            {
+                chunks.swap(other.chunks);
+                std::swap(fill,other.fill);
+            }
+            static int getChunkCoordinate(int coordinate)
+            {
+                // floor division, so that negative coordinates land in negative chunks
+                if (coordinate < 0)
+                {
+                    return ((coordinate+1)/CHUNK_SIZE)-1;
+                }
+                return coordinate/CHUNK_SIZE;
+            }
+            static ChunkIndex getChunkIndex(const sf3d::Vector2i& position)
+            {
+                return ChunkIndex(getChunkCoordinate(position.x),getChunkCoordinate(position.y));
+            }
+            static int getLocal(int coordinate)
+            {
+                return coordinate-(getChunkCoordinate(coordinate)*CHUNK_SIZE);
+            }
+        private:
+            T fill;
+            Chunks chunks;
+    };
+}
+
+#endif // NFE_SPARSE_GRID_HPP
@@ -7,6 +7,9 @@
 
 #define AGENT_SLEEP_TIME 10
 
+/// Longest time in milliseconds an agent stays parked on the tuple space, so that it still notices a shutdown.
+#define AGENT_WAIT_TIME 100
+
 class Agent
 {
 public:
@@ -16,6 +19,9 @@ public:
     bool getIsShutdown();
 
 protected:
+    /// Starts the agent thread. Called last by the constructor of each concrete agent, so that the thread never
+    /// sees a member, such as an interned tag, that the derived constructor has not set yet.
+    void start();
     void run();
     void destroy();
     virtual void poll();
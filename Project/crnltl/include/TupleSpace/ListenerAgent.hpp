@@ -18,6 +18,7 @@ protected:
     bool mIsInitialized;
     sf3d::TcpListener * mListener;
     Tuple * mTupleToSubmit;
+    TupleSpace::TagId mConnectionTag;
 };
 
 #endif
@@ -14,9 +14,9 @@ protected:
     TcpReceiveAgent* mReceiveAgent;
     TcpSendAgent* mSendAgent;
     TcpListenerAgent* mListenAgent;
-    HANDLE mBlockingListener;
     Tuple* mNewConnectionData;
     bool mHasNewConnection;
+    TupleSpace::TagId mConnectionTag;
 
 
     /***** CONSTRUCTORS/DESTRUCTORS *****/
@@ -27,6 +27,9 @@ protected:
     /// The current number of client connections.
     unsigned char mConnectionCount;
 
+    /// Interned tag new client connections are submitted under.
+    TupleSpace::TagId mConnectionTag;
+
 
     /***** CONSTRUCTORS / DESTRUCTORS *****/
 public:
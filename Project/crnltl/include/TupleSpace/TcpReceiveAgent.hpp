@@ -24,6 +24,9 @@ protected:
     /// Does the packet contain data that is ready to be pushed to TupleSpace?
     bool isReadyToPush;
 
+    /// Interned tag the received packets are pushed under.
+    TupleSpace::TagId mReceiveTag;
+
 
 /***** CONSTRUCTORS / DESTRUCTORS *****/
 public:
@@ -39,6 +42,10 @@ public:
     /// Sends retrieved data to TupleSpace.
     void submit();
 
+protected:
+    /// Interrupts the receive tag, so that a put blocked on a full ring lets the thread be joined.
+    void onShutdown();
+
 private:
     /// Adds a new connection that this agent could receive data from.
     void setConnections(unsigned char connectionCount, sf3d::TcpSocket** sockets);
@@ -25,8 +25,8 @@ protected:
     /// Pointers to the sockets that will be used to send data.
     sf3d::TcpSocket** mSockets;
 
-    /// Semaphore to be registered with the tuple space. Will block until packets are available to send.
-    HANDLE mBlockingListener;
+    /// Interned tag the packets to send are taken from.
+    TupleSpace::TagId mReadyTag;
 
 
 /***** CONSTRUCTORS/ DESTRUCTORS *****/
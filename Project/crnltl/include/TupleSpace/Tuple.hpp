@@ -1,49 +1,71 @@
 #ifndef _TUPLE_HPP_
 #define _TUPLE_HPP_
 
+#include <atomic>
 #include <cstdarg>
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
 
+/// Number of items a tuple holds in place before its item list has to be allocated
+#define TUPLE_INLINE_ITEMS 8
+
+/// Longest string an item holds in place, longer ones live in a buffer shared by the copies of the item
+#define TUPLE_SHORT_STRING 14
+
 /// A C++ wrapper for a Python tuple
 class Tuple
 {
     /***** NESTED CLASSES *****/
     public:
-        /// A parent struct for items
-        struct BasicItem
+        /// The buffer of a long string, freed along with the last item referring to it
+        struct StringBuffer
         {
-            /// Basic constructor
-            BasicItem() {};
-
-            /// Basic destructor
-            virtual ~BasicItem() {};
+            std::atomic<unsigned int> mReferences;
+            std::size_t mSize;
+            char mData[1];
         };
 
-        /// A specialized struct for items
-        template<typename T> struct Item : BasicItem
+        /// An item, whose type is given by the code of the tuple or template holding it
+        struct Item
         {
-            /// The tuple item itself
-            T mItem;
-
-            /// Basic constructor
-            Item<T>(T item) : mItem(item) {};
-
-            /// Basic destructor
-            ~Item<T>() {};
+            union
+            {
+                bool mBool;
+                int mInt;
+                float mFloat;
+                double mDouble;
+                char mChar;
+                long mLong;
+                unsigned int mUnsignedInt;
+                void* mVoid;
+
+                /// A long string
+                StringBuffer* mBuffer;
+
+                /// A short string, null terminated, with its length in the last byte, which marks a long string instead when it is past TUPLE_SHORT_STRING
+                char mString[TUPLE_SHORT_STRING + 2];
+            };
+
+            /// Makes the item a string, allocating only when it is longer than TUPLE_SHORT_STRING. The item must not hold a string yet.
+            void setString(const char* data, std::size_t size);
+
+            /// Return the characters, null terminated, and the length of a string item
+            const char* getString() const;
+            std::size_t getStringSize() const;
         };
 
     /***** CONSTRUCTORS / DESTRUCTORS *****/
     public:
         /// Empty constructor
-        Tuple() {}
+        Tuple() : mSize(0), mCapacity(TUPLE_INLINE_ITEMS), mItems(mInlineItems), mCode(mInlineCode) {}
 
         /// Constructor which builds the item list from a variable number of arguments and code for their respective types
-        Tuple(std::string code, ...);
+        Tuple(const char* code, ...);
 
         /// Constructor which builds the item list and then appends items from a given tuple
-        Tuple(Tuple * tuple, std::string code, ...);
+        Tuple(Tuple * tuple, const char* code, ...);
 
         /// Destructor which destroys the item list
         virtual ~Tuple();
@@ -66,15 +88,54 @@ class Tuple
         unsigned int getSize() const;
 
         /// Returns the code of the item list
-        const std::string& getCode() const;
+        std::string getCode() const;
+
+        /// Returns the code of the item at a given index, or 0 past the end of the item list
+        char getItemCode(unsigned int index) const;
+
+        /// Returns the item at a given index, or nullptr past the end of the item list
+        const Item* getItem(unsigned int index) const;
+
+        /// Returns a hash of the item at a given index which takes its type into account
+        std::size_t getItemHash(unsigned int index) const;
+
+        /// Appends an item of a given type to the item list, which takes over the string buffer it may hold
+        void addItem(char code, const Item& item);
+
+        /// Builds an item of a given type from the next argument of a list, or returns false for an unknown code
+        static bool createItem(char code, va_list* list, Item& item);
+
+        /// Copies an item of a given type, sharing the buffer of a long string
+        static void copyItem(char code, const Item& source, Item& target);
+
+        /// Releases whatever an item of a given type holds
+        static void destroyItem(char code, Item& item);
+
+        /// Returns whether two items of a given type hold the same value
+        static bool isItemEqual(char code, const Item* left, const Item* right);
+
+        /// Returns a hash of an item of a given type which takes the type into account
+        static std::size_t hashItem(char code, const Item* item);
+
+    protected:
+        /// Appends the items built from a code and its arguments, leaving out unknown codes
+        void append(const char* code, va_list* list);
+
+    private:
+        Tuple(const Tuple&);
+        Tuple& operator=(const Tuple&);
 
     /***** ATTRIBUTES *****/
     protected:
-        /// The code for the arguments that were initially passed to the constructor
-        std::string mCode;
+        unsigned int mSize;
+        unsigned int mCapacity;
+
+        /// The item list and the code of every item, which are the inline arrays below until the tuple outgrows them
+        Item* mItems;
+        char* mCode;
 
-        /// The item list
-        std::vector<BasicItem*> mItems;
+        Item mInlineItems[TUPLE_INLINE_ITEMS];
+        char mInlineCode[TUPLE_INLINE_ITEMS];
 
         /// Master list of compatible types
         static std::map<char, std::vector<char>> mCompatibleTypes;
@@ -0,0 +1,135 @@
+#ifndef _TUPLE_LOG_HPP_
+#define _TUPLE_LOG_HPP_
+
+#include <TupleSpace/Tuple.hpp>
+#include <NFE/MappedFile.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Size a log file is created with. It doubles whenever the records outgrow it.
+#define TUPLE_LOG_INITIAL_SIZE (1 << 20)
+
+/// Longest time in milliseconds a record waits for the group commit that makes it durable, unless somebody syncs on it.
+#define TUPLE_LOG_COMMIT_PERIOD 5
+
+/// A log is compacted once it holds more than this many bytes and twice as many as after its last compaction.
+#define TUPLE_LOG_COMPACT_SIZE (4 << 20)
+
+/// A write-ahead log of the puts and gets of tags, appended to a memory mapped file and made durable by group commits from a thread of its own.
+/// Void pointer items are logged as nullptr, since their addresses mean nothing to the next process.
+class TupleLog
+{
+    /***** NESTED CLASSES *****/
+public:
+    /// The tuples left in a log after a replay, in order of their sequence numbers, by tag.
+    typedef std::map<std::string, std::map<unsigned long long, Tuple*>> Contents;
+
+    /***** CONSTRUCTORS / DESTRUCTORS *****/
+public:
+    TupleLog();
+
+    /// Commits and closes the log.
+    ~TupleLog();
+
+    /***** METHODS *****/
+public:
+    /// Opens the log at a path, creating it if there is none, and replays it into contents, which then own the tuples.
+    /// The replay stops at the first record torn by a crash. Returns false if the log is already open or the file is not a log.
+    bool open(const std::string& path, Contents& contents);
+
+    /// Commits whatever was appended and closes the log.
+    void close();
+
+    bool isOpen();
+
+    /// Append a record for the put of a tuple or the get of the tuple with a sequence number under a tag.
+    /// Return the position sync() has to reach for the record to be durable, or 0 if the log is closed or has failed.
+    std::uint64_t logPut(const std::string& tag, unsigned long long sequence, Tuple* t);
+    std::uint64_t logGet(const std::string& tag, unsigned long long sequence);
+
+    /// Parks the calling thread until the log is committed up to a position, along with every other record appended by then.
+    /// Returns false if the log failed or was closed before getting there.
+    bool sync(std::uint64_t position);
+
+    /// Starts replacing the log with one that only holds the puts given to addEntry(), which have to be all the log holds as of this call.
+    /// The records appended until endRewrite() are carried over to the new log. Returns false if the log is closed, has failed or is being rewritten already.
+    bool beginRewrite();
+    void addEntry(const std::string& tag, unsigned long long sequence, Tuple* t);
+
+    /// Writes the new log and swaps it in, only locking the log for the records carried over. Returns false, keeping the old log, if the new one cannot be written.
+    bool endRewrite();
+
+    /// Sets what the commit thread calls when the log has grown enough to be compacted, without any lock of the log held.
+    void setCompaction(std::function<void()> compaction);
+
+    /***** ATTRIBUTES *****/
+protected:
+    enum Type
+    {
+        PUT = 1,
+        GET = 2
+    };
+
+    /// Encodes a record, with its size and checksum, at the end of a buffer.
+    static void encode(std::vector<unsigned char>& buffer, Type type, const std::string& tag, unsigned long long sequence, Tuple* t);
+
+    /// Decodes the records of a mapped file, returning where the valid ones end.
+    static std::uint64_t decode(const unsigned char* data, std::uint64_t size, Contents& contents);
+
+    /// Decodes the tuple of a put record, or returns nullptr if it is malformed.
+    static Tuple* decodeTuple(const unsigned char*& data, const unsigned char* end);
+
+    static std::uint32_t getChecksum(const unsigned char* data, std::size_t size);
+
+    /// Writes the header and the records of a buffer to a new file.
+    static bool writeFile(const std::string& path, const std::vector<unsigned char>& records);
+
+    /// Copies the records in mBuffer to the end of the file, growing it as needed, and returns the new position, or 0 if the log has failed. The log has to be locked.
+    std::uint64_t append();
+
+    void runCommits();
+
+    std::string mPath;
+    NFE::MappedFile mFile;
+
+    /// Guards everything but the flushes, which only take mFlushMutex so that appends go on meanwhile. Anything that maps the file again takes both, in that order.
+    std::mutex mMutex;
+    std::mutex mFlushMutex;
+
+    std::vector<unsigned char> mBuffer;
+
+    /// Where the next record goes in the file, and where the last commit reached.
+    std::uint64_t mEnd;
+    std::uint64_t mFlushedEnd;
+    std::uint64_t mCompactedEnd;
+
+    /// Bytes ever appended, committed and asked to be committed, which positions count in as they survive rewrites.
+    std::uint64_t mAppended;
+    std::uint64_t mCommitted;
+    std::uint64_t mRequested;
+
+    /// Bumped by rewrites, so that a commit that raced one does not move mFlushedEnd.
+    unsigned long long mGeneration;
+
+    /// Set when the file could not grow or be flushed, after which nothing is logged or committed until the log is opened again.
+    bool mFailed;
+
+    /// The records of a rewrite in progress, which only its thread touches, and those appended since it began, which are guarded by mMutex.
+    bool mRewriting;
+    std::vector<unsigned char> mRewriteBuffer;
+    std::vector<unsigned char> mCarried;
+
+    std::thread mThread;
+    std::condition_variable mCommitCondition;
+    std::condition_variable mSyncCondition;
+    bool mStop;
+    std::function<void()> mCompaction;
+};
+
+#endif
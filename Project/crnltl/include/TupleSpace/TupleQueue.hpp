@@ -0,0 +1,98 @@
+#ifndef _TUPLE_QUEUE_HPP_
+#define _TUPLE_QUEUE_HPP_
+
+#include <TupleSpace/Tuple.hpp>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+/// Number of tuples held by a chunk of a queue.
+#define TUPLE_QUEUE_CHUNK_SIZE 64
+
+/// Number of chunks released to a pool between two trims of its spare chunks.
+#define TUPLE_QUEUE_TRIM_PERIOD 256
+
+/// A FIFO of tuples stored in fixed size chunks, which are taken from and given back to a pool instead of the allocator.
+/// It is not thread safe, the owner has to lock both the queue and its pool.
+class TupleQueue
+{
+    /***** NESTED CLASSES *****/
+public:
+    struct Chunk
+    {
+        Tuple* mSlots[TUPLE_QUEUE_CHUNK_SIZE];
+
+        /// When each tuple was queued, if its owner keeps track.
+        std::chrono::steady_clock::time_point mStamps[TUPLE_QUEUE_CHUNK_SIZE];
+
+        /// Links the spare chunks of a pool.
+        Chunk* mNext;
+    };
+
+    /// Spare chunks shared by the queues of one lock.
+    /// The spares are trimmed every TUPLE_QUEUE_TRIM_PERIOD releases, down to what it takes to reach the most chunks in use since the last trim.
+    class Pool
+    {
+    public:
+        Pool();
+
+        /// Frees the spare chunks, every chunk has to be released by then.
+        ~Pool();
+
+        Chunk* acquire();
+        void release(Chunk* chunk);
+
+        /// Frees the spare chunks that were not needed since the last trim.
+        void trim();
+
+        std::size_t getSpareCount() const;
+        std::size_t getUsedCount() const;
+
+    protected:
+        Chunk* mSpares;
+        std::size_t mSpareCount;
+        std::size_t mUsedCount;
+
+        /// The most chunks in use at once since the last trim.
+        std::size_t mHighWater;
+        std::size_t mReleaseCount;
+
+    private:
+        Pool(const Pool&);
+        Pool& operator=(const Pool&);
+    };
+
+    /***** CONSTRUCTORS / DESTRUCTORS *****/
+public:
+    TupleQueue(Pool* pool);
+
+    /// Gives the chunks back to the pool, the tuples still queued are not deleted.
+    ~TupleQueue();
+
+    /***** METHODS *****/
+public:
+    void push_back(Tuple* t);
+    void pop_front();
+    Tuple*& front();
+    Tuple*& operator[](std::size_t position);
+    std::chrono::steady_clock::time_point& getStamp(std::size_t position);
+    bool empty() const;
+    std::size_t size() const;
+
+    /***** ATTRIBUTES *****/
+protected:
+    Pool* mPool;
+
+    /// Chunks in queue order. An empty queue keeps one, so that a tag which keeps emptying does not go back to the pool.
+    std::vector<Chunk*> mChunks;
+
+    /// Position of the front in the first chunk.
+    std::size_t mBegin;
+    std::size_t mSize;
+
+private:
+    TupleQueue(const TupleQueue&);
+    TupleQueue& operator=(const TupleQueue&);
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _TUPLE_RING_HPP_
+#define _TUPLE_RING_HPP_
+
+#include <TupleSpace/Tuple.hpp>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/// Size of the padding that keeps the producer and consumer sides of a ring on different cache lines.
+#define TUPLE_RING_CACHE_LINE 64
+
+/// A bounded lock-free ring of tuples for tags with a known number of producers and a single consumer.
+class TupleRing
+{
+    /***** NESTED CLASSES *****/
+public:
+    enum Mode
+    {
+        /// One producing thread and one consuming thread.
+        SPSC,
+
+        /// Any number of producing threads and one consuming thread.
+        MPSC
+    };
+
+    /***** CONSTRUCTORS / DESTRUCTORS *****/
+public:
+    /// The capacity is rounded up to a power of two.
+    TupleRing(Mode mode, unsigned int capacity);
+
+    /// Deletes the tuples still held by the ring.
+    ~TupleRing();
+
+    /***** METHODS *****/
+public:
+    /// Appends a tuple, or returns false without taking it when the ring is full.
+    bool push(Tuple* t);
+
+    /// Appends as many of the tuples as fit, in order, and returns how many were taken.
+    std::size_t push(Tuple* const* tuples, std::size_t count);
+
+    /// Takes the oldest tuple, or returns nullptr when the ring is empty. Only the consumer may call this.
+    Tuple* pop();
+
+    /// Appends up to max of the oldest tuples to out and returns how many were taken. Only the consumer may call this.
+    std::size_t pop(std::vector<Tuple*>& out, std::size_t max);
+
+    /// Returns whether the ring holds no tuple, as seen by the consumer.
+    bool isEmpty() const;
+
+    /// Returns roughly how many tuples the ring holds, as it may change while this reads.
+    std::size_t getSize() const;
+
+    Mode getMode() const;
+    unsigned int getCapacity() const;
+
+    /***** ATTRIBUTES *****/
+protected:
+    struct Slot
+    {
+        /// Only used in MPSC mode, tells producers and the consumer whose turn the slot is.
+        std::atomic<std::size_t> mSequence;
+        Tuple* mTuple;
+    };
+
+    Mode mMode;
+    std::size_t mMask;
+    Slot* mSlots;
+
+    char mPadding0[TUPLE_RING_CACHE_LINE];
+
+    /// Written by the producers.
+    std::atomic<std::size_t> mTail;
+
+    /// The last head a SPSC producer has seen, so it only reads the consumer's line when the ring looks full.
+    std::size_t mCachedHead;
+
+    char mPadding1[TUPLE_RING_CACHE_LINE];
+
+    /// Written by the consumer.
+    std::atomic<std::size_t> mHead;
+
+    /// The last tail a SPSC consumer has seen, so it only reads the producer's line when the ring looks empty.
+    std::size_t mCachedTail;
+
+    char mPadding2[TUPLE_RING_CACHE_LINE];
+};
+
+#endif
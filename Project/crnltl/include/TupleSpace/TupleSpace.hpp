@@ -2,37 +2,417 @@
 #define _TUPLE_SPACE_HPP_
 
 #include <TupleSpace/Tuple.hpp>
-#include <windows.h>
-#include <map>
+#include <TupleSpace/TupleLog.hpp>
+#include <TupleSpace/TupleQueue.hpp>
+#include <TupleSpace/TupleRing.hpp>
+#include <TupleSpace/TupleTemplate.hpp>
+#include <unordered_map>
 #include <string>
-#include <queue>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <thread>
+#include <condition_variable>
 #include <mutex>
+#include <shared_mutex>
 
 #define TUPLE_SPACE TupleSpace::getSingletonPtr()
 
+/// Number of independently locked shards the tags are spread over.
+#define TUPLE_SPACE_SHARD_COUNT 16
+
+/// Number of tag ids, counted from 0, that can be backed by a lock-free ring.
+#define TUPLE_SPACE_RING_COUNT 256
+
+/// Number of buckets of the tuple age histogram. Bucket 0 counts ages under a microsecond, bucket i ages from 2^(i-1) up to 2^i microseconds, and the last one everything older.
+#define TUPLE_SPACE_AGE_BUCKETS 24
+
 class TupleSpace
 {
 public:
+    /// An interned tag. Ids are handed out in order from 0 and stay valid for the lifetime of the tuple space.
+    typedef unsigned int TagId;
+
+    /// What a put does to a tag that already holds as many tuples as its capacity.
+    enum Overflow
+    {
+        /// Parks the producer until a consumer makes room or the tag is interrupted.
+        BLOCK,
+
+        /// Deletes the oldest tuple of the tag to make room. Ring tags cannot do this, as only their consumer may take.
+        DROP_OLDEST,
+
+        /// Deletes the tuple being put.
+        DROP_NEWEST,
+
+        /// Refuses the tuple being put, which stays with the caller.
+        FAIL
+    };
+
+    /// Whether the tuples of a tag outlive the process, through the write-ahead log opened by openLog().
+    /// Durable tags refuse puts while no log is open or after it failed, rather than silently keeping the tuples in memory only.
+    enum Durability
+    {
+        /// The tuples only live in memory, which suits hot tags.
+        MEMORY,
+
+        /// Puts and gets are logged and made durable by the next group commit, so a crash may lose the last few milliseconds of them.
+        LOGGED,
+
+        /// As LOGGED, but a put only returns once the group commit that makes it durable is done. The tuples of a commit that fails are taken back, unless they were already taken.
+        SYNCED
+    };
+
+    /// A snapshot of the counters of a tag, as returned by getMetrics(). Only drops and blocked time are counted while metrics are disabled.
+    struct TagMetrics
+    {
+        TagId mTag;
+        std::string mName;
+        bool mRing;
+        unsigned long long mPutCount;
+        unsigned long long mGetCount;
+        std::size_t mDepth;
+        std::size_t mMaxDepth;
+        unsigned long long mDropCount;
+        std::chrono::microseconds mBlockedTime;
+
+        /// How long the tuples that were taken had been queued, see TUPLE_SPACE_AGE_BUCKETS. Not kept for ring tags.
+        unsigned long long mAges[TUPLE_SPACE_AGE_BUCKETS];
+
+        /// Operations that locked the shard of the tag, and how long they waited for and held the lock. Ring tags only lock to park.
+        unsigned long long mLockCount;
+        std::chrono::microseconds mLockWaitTime;
+        std::chrono::microseconds mLockHoldTime;
+    };
+
     TupleSpace();
     virtual ~TupleSpace();
-    void put(const std::string& tag, Tuple* t);
+
+    /// Returns false if the tuple was refused under FAIL, a blocked put was interrupted or the log of a durable tag could not take it, in which case the tuple still belongs to the caller.
+    bool put(const std::string& tag, Tuple* t);
+    bool put(TagId tag, Tuple* t);
     Tuple* get(const std::string& tag);
+    Tuple* get(TagId tag);
+
+    /// Puts a batch of tuples to a tag in order, under a single lock and a single wakeup.
+    /// Returns how many of the tuples were taken, counting the ones dropped, the others still belong to the caller.
+    std::size_t putMany(const std::string& tag, const std::vector<Tuple*>& tuples);
+    std::size_t putMany(TagId tag, const std::vector<Tuple*>& tuples);
+
+    /// Appends up to max of the oldest tuples of a tag to out under a single lock, without waiting, and returns how many were taken.
+    std::size_t drain(const std::string& tag, std::vector<Tuple*>& out, std::size_t max = std::numeric_limits<std::size_t>::max());
+    std::size_t drain(TagId tag, std::vector<Tuple*>& out, std::size_t max = std::numeric_limits<std::size_t>::max());
+
+    /// Takes the oldest tuple of a tag, parking the calling thread until one is put or the timeout expires. Returns nullptr on timeout or interrupt.
+    Tuple* get(const std::string& tag, std::chrono::microseconds timeout);
+    Tuple* get(TagId tag, std::chrono::microseconds timeout);
+
+    /// Takes the oldest tuple of a tag, parking the calling thread for as long as it takes. Returns nullptr only on interrupt.
+    Tuple* waitFor(const std::string& tag);
+    Tuple* waitFor(TagId tag);
+
+    /// Wakes every thread currently waiting on a tag, which then returns nullptr, so that a consumer can be shut down.
+    /// Producers blocked on the capacity of the tag give up as well.
+    void interrupt(TagId tag);
+
+    /// Limits the number of tuples queued under a tag, 0 meaning no limit, and chooses what a put does past it. Returns false for ring tags, which are bounded at registration.
+    bool setCapacity(const std::string& tag, unsigned int capacity, Overflow overflow = BLOCK);
+    bool setCapacity(TagId tag, unsigned int capacity, Overflow overflow = BLOCK);
+
+    /// Returns how many tuples were dropped or refused by the overflow policy of a tag.
+    unsigned long long getDropCount(TagId tag);
 
-    /// Registers a semaphore with the listener registry. This semaphore will be incremented whenever a new element is added to the tuple space using the corresponding tag.
-    bool registerBlockingListener(std::string tag, HANDLE semaphore);
+    /// Returns how long producers have spent blocked on the capacity of a tag, added up over all of them.
+    std::chrono::microseconds getBlockedTime(TagId tag);
 
-    /// Unregisters and deletes a semaphore from the listener registry.
-    void unregisterBlockingListener(std::string tag);
+    /// Linda operations on the tuples of a tag. out() is a put, in() takes the oldest tuple matching a template and rd() returns a copy of it, leaving it in place.
+    /// in() and rd() park the calling thread until a match is put and return nullptr only on interrupt, inp() and rdp() return nullptr at once instead.
+    /// Ring tags only support out().
+    bool out(const std::string& tag, Tuple* t);
+    bool out(TagId tag, Tuple* t);
+    Tuple* in(const std::string& tag, const TupleTemplate& pattern);
+    Tuple* in(TagId tag, const TupleTemplate& pattern);
+    Tuple* inp(const std::string& tag, const TupleTemplate& pattern);
+    Tuple* inp(TagId tag, const TupleTemplate& pattern);
+    Tuple* rd(const std::string& tag, const TupleTemplate& pattern);
+    Tuple* rd(TagId tag, const TupleTemplate& pattern);
+    Tuple* rdp(const std::string& tag, const TupleTemplate& pattern);
+    Tuple* rdp(TagId tag, const TupleTemplate& pattern);
+
+    /// Keeps a hash index on a field of the tuples of a tag, so that templates with an actual value in that field are matched without a scan.
+    /// The index lasts for the lifetime of the tuple space. Returns false for ring tags.
+    bool addIndex(const std::string& tag, unsigned int field);
+    bool addIndex(TagId tag, unsigned int field);
+
+    /// Backs a tag with a lock-free ring instead of a locked queue, for the lifetime of the tuple space.
+    /// The mode declares how many threads put to the tag, and only one thread may get from it. A put to a full ring waits for the consumer.
+    /// This has to happen before the tag is first used. Returns false if the tag is in use, already registered or its id is past TUPLE_SPACE_RING_COUNT.
+    bool registerTag(const std::string& tag, TupleRing::Mode mode, unsigned int capacity = 1024, Overflow overflow = BLOCK);
+    bool registerTag(TagId tag, TupleRing::Mode mode, unsigned int capacity = 1024, Overflow overflow = BLOCK);
+
+    /// Turns the per tag counters of getMetrics() on or off. They cost a few clock reads per operation, and nothing but a flag check when off.
+    void setMetricsEnabled(bool enabled);
+    bool getMetricsEnabled() const;
+
+    /// Returns the counters of every tag that has been used.
+    std::vector<TagMetrics> getMetrics();
+
+    /// Writes the counters of every tag that has been used as one JSON object per line.
+    void dumpMetrics(std::ostream& stream);
+
+    /// Enables metrics and dumps them every period from a thread of their own, appending to a file or writing to stdout for an empty path.
+    /// A zero period stops the dumps.
+    void setMetricsDump(const std::string& path, std::chrono::milliseconds period);
+
+    /// Opens a write-ahead log, creating it if there is none, and queues the tuples it still holds back under their tags, which are made LOGGED unless they already are durable.
+    /// Only one log can be open, and this should happen before the tags it holds are used. The log is compacted right away and then whenever it has grown enough.
+    /// A log that exists but cannot be read is left untouched. If the first compaction fails, the log is closed and the tuples it held leave their tags again.
+    /// A get is durable once the next group commit is done, so a tuple taken just before a crash comes back after it.
+    bool openLog(const std::string& path);
+
+    /// Commits and closes the log, after which durable tags refuse puts until one is opened again.
+    void closeLog();
+
+    /// Chooses whether the tuples of a tag are logged, along with those already queued. Returns false for ring tags.
+    bool setDurability(const std::string& tag, Durability durability);
+    bool setDurability(TagId tag, Durability durability);
+
+    /// Rewrites the log with only the tuples queued under durable tags, which are only locked while their tuples are encoded. Returns false if no log is open or it could not be rewritten.
+    bool compactLog();
+
+    /// Returns the id of a tag, interning it on first use. Hot paths should intern their tags once and keep the ids.
+    TagId intern(const std::string& tag);
+
+    /// Returns the tag an id was interned from, or an empty string for an unknown id.
+    std::string getTagName(TagId tag);
 
     static TupleSpace* getSingletonPtr();
 
 
 protected:
-    std::map<std::string, std::queue<Tuple*>*> mSpace;
-    std::mutex mMutex;
+    /// A hash index over one field of the tuples of a channel, from value hashes to sequence numbers in queue order.
+    struct Index
+    {
+        unsigned int mField;
+        std::unordered_map<std::size_t, std::deque<unsigned long long>> mEntries;
+    };
+
+    /// The counters of a queue tag which are only kept while metrics are enabled.
+    struct Counters
+    {
+        Counters() : mPutCount(0), mGetCount(0), mMaxDepth(0), mLockCount(0), mLockWaitTime(0), mLockHoldTime(0)
+        {
+            for (unsigned int i = 0; i != TUPLE_SPACE_AGE_BUCKETS; ++i)
+                mAges[i] = 0;
+        }
+
+        unsigned long long mPutCount;
+        unsigned long long mGetCount;
+        std::size_t mMaxDepth;
+        unsigned long long mAges[TUPLE_SPACE_AGE_BUCKETS];
+        unsigned long long mLockCount;
+        std::chrono::steady_clock::duration mLockWaitTime;
+        std::chrono::steady_clock::duration mLockHoldTime;
+    };
+
+    /// The queue of a tag along with the threads parked on it. It is created on first use and kept for the lifetime of the tuple space.
+    struct Channel
+    {
+        Channel(TupleQueue::Pool* pool) : mQueue(pool), mFirst(0), mCount(0), mWaiterCount(0), mMatcherCount(0), mInterruptCount(0), mCapacity(0), mOverflow(BLOCK), mBlockedCount(0), mDropCount(0), mBlockedTime(0), mDurability(MEMORY), mLogPosition(0) {}
+
+        /// Tuples taken out of the middle by in() leave a nullptr behind, but the front is always a tuple.
+        TupleQueue mQueue;
+
+        /// The sequence number of the front of the queue, which only ever grows.
+        unsigned long long mFirst;
+
+        /// The number of tuples queued, leaving out the holes.
+        std::size_t mCount;
+
+        std::vector<Index> mIndexes;
+        std::condition_variable mCondition;
+        unsigned int mWaiterCount;
+
+        /// Waiters with a template, which every put has to wake since any of them may match.
+        unsigned int mMatcherCount;
+        unsigned int mInterruptCount;
+
+        unsigned int mCapacity;
+        Overflow mOverflow;
+
+        /// Producers parked until the queue drops below its capacity.
+        std::condition_variable mSpaceCondition;
+        unsigned int mBlockedCount;
+        unsigned long long mDropCount;
+        std::chrono::steady_clock::duration mBlockedTime;
+        Counters mCounters;
+
+        /// The tag the records of a durable channel are logged under, and where the log has to be committed up to for the last of them.
+        Durability mDurability;
+        std::string mLogName;
+        std::uint64_t mLogPosition;
+    };
+
+    /// The channels of the tags that hash to it, behind a lock of its own.
+    struct Shard
+    {
+        std::mutex mMutex;
+        std::unordered_map<TagId, Channel*> mSpace;
+
+        /// Queue storage for the channels, which is only touched under the lock.
+        TupleQueue::Pool mPool;
+
+        /// Keeps the locks of neighbouring shards off the same cache line.
+        char mPadding[64];
+    };
+
+    /// A tag registered with a ring, along with the threads parked on it.
+    struct RingChannel
+    {
+        RingChannel(TupleRing::Mode mode, unsigned int capacity, Overflow overflow) : mRing(mode, capacity), mWaiterCount(0), mSpaceWaiterCount(0), mInterruptCount(0), mOverflow(overflow), mDropCount(0), mBlockedTime(0), mPutCount(0), mGetCount(0), mMaxDepth(0) {}
+
+        TupleRing mRing;
+        std::condition_variable mCondition;
+
+        /// Read by producers without a lock, so that a put only touches the shard when somebody waits.
+        std::atomic<unsigned int> mWaiterCount;
+
+        /// Producers parked until the ring has room, which the consumer likewise reads without a lock after a get.
+        std::condition_variable mSpaceCondition;
+        std::atomic<unsigned int> mSpaceWaiterCount;
+
+        std::atomic<unsigned int> mInterruptCount;
+
+        Overflow mOverflow;
+        std::atomic<unsigned long long> mDropCount;
+
+        /// In microseconds.
+        std::atomic<long long> mBlockedTime;
+
+        /// Only kept while metrics are enabled.
+        std::atomic<unsigned long long> mPutCount;
+        std::atomic<unsigned long long> mGetCount;
+        std::atomic<std::size_t> mMaxDepth;
+    };
+
+    /// Holds the lock of a shard for an operation on a tag, and times how long it waited for and held the lock while metrics are enabled.
+    class ShardLock
+    {
+    public:
+        ShardLock(TupleSpace* space, Shard& shard);
+
+        /// Charges the lock times to the channel, if any, before unlocking.
+        ~ShardLock();
+
+        /// Sets the channel the lock times are charged to.
+        void charge(Channel* channel);
+
+        /// Charges the lock times and unlocks before the end of the scope.
+        void unlock();
+
+        /// Parks on a condition, which releases the lock, leaving the time parked out of the time held.
+        template<typename Predicate> void wait(std::condition_variable& condition, Predicate ready)
+        {
+            pause();
+            condition.wait(mLock, ready);
+            resume();
+        }
+
+        template<typename Predicate> bool waitUntil(std::condition_variable& condition, const std::chrono::steady_clock::time_point& deadline, Predicate ready)
+        {
+            pause();
+            bool result = condition.wait_until(mLock, deadline, ready);
+            resume();
+            return result;
+        }
+
+    protected:
+        void pause();
+        void resume();
+
+        bool mTimed;
+        std::unique_lock<std::mutex> mLock;
+        Channel* mChannel;
+        std::chrono::steady_clock::time_point mAcquired;
+        std::chrono::steady_clock::duration mWaited;
+        std::chrono::steady_clock::duration mHeld;
+    };
+
+    Shard& getShard(TagId tag);
+    RingChannel* getRing(TagId tag);
+
+    /// Returns the channel of a tag, creating it on first use. The shard has to be locked.
+    Channel* getChannel(Shard& shard, TagId tag);
+
+    /// Wakes the consumer of a ring after a put, if it is parked.
+    void signal(TagId tag, RingChannel* ring);
+
+    /// Wakes the producers of a ring after a get, if they are parked on it being full. The shard is only locked for it when not already held.
+    void release(TagId tag, RingChannel* ring, bool locked = false);
+
+    /// Pushes tuples to a ring, applying its overflow policy, and returns how many were taken.
+    std::size_t push(TagId tag, RingChannel* ring, Tuple* const* tuples, std::size_t count);
+
+    /// Queues tuples to a channel, applying its capacity and overflow policy, and returns how many were taken. The shard has to be locked.
+    /// The sequence number each tuple was queued under goes to sequences, if given.
+    std::size_t admit(Channel* channel, ShardLock& lock, Tuple* const* tuples, std::size_t count, unsigned long long* sequences = nullptr);
+
+    /// Waits on the channel of a tag until it holds a tuple, the deadline passes or it is interrupted. The shard has to be locked.
+    Tuple* wait(Shard& shard, TagId tag, ShardLock& lock, const std::chrono::steady_clock::time_point* deadline);
+
+    /// Returns where a put has to wait for the log to be committed up to, or 0 if the channel is not SYNCED.
+    std::uint64_t getCommit(Channel* channel);
+
+    /// Logs, queues and indexes a tuple, or returns false if the channel is durable and the log could not take it. The shard has to be locked.
+    /// A tuple replayed from the log is not logged again, as it already is there.
+    bool append(Channel* channel, Tuple* t, bool logged = true);
+
+    /// Takes back the last tuples of a put whose commit failed, for as long as they are still queued under their sequence numbers, and returns how many are left.
+    std::size_t withdraw(Shard& shard, TagId tag, Tuple* const* tuples, const unsigned long long* sequences, std::size_t count);
+
+    /// Takes the tuple at a position of the queue out of it, its indexes and the log, counting it as a get unless it is dropped. The shard has to be locked.
+    Tuple* remove(Channel* channel, std::size_t position, bool taken = true);
+
+    /// Count tuples pushed to and taken from a ring while metrics are enabled.
+    void countPuts(RingChannel* ring, std::size_t pushed);
+    void countGets(RingChannel* ring, std::size_t taken);
+
+    /// Returns the age histogram bucket of a duration.
+    static unsigned int getAgeBucket(std::chrono::steady_clock::duration age);
+
+    /// Body of the metrics dump thread.
+    void runMetricsDump(std::string path, std::chrono::milliseconds period);
+
+    /// Returns the position of the oldest tuple matching a template, or the size of the queue if there is none. The shard has to be locked.
+    std::size_t find(Channel* channel, const TupleTemplate& pattern);
+
+    /// Shared by in(), inp(), rd() and rdp().
+    Tuple* match(TagId tag, const TupleTemplate& pattern, bool remove, bool block);
+
+    Shard mShards[TUPLE_SPACE_SHARD_COUNT];
+
+    /// Rings by tag id, set once by registerTag() and read without a lock.
+    std::atomic<RingChannel*> mRings[TUPLE_SPACE_RING_COUNT];
+
+    /// Interned tags, only written the first time a tag is seen.
+    std::shared_timed_mutex mTagMutex;
+    std::unordered_map<std::string, TagId> mTags;
+    std::vector<std::string> mTagNames;
+
+    std::atomic<bool> mMetricsEnabled;
+
+    /// The metrics dump thread, which sleeps on the condition between dumps.
+    std::thread mDumpThread;
+    std::mutex mDumpMutex;
+    std::condition_variable mDumpCondition;
+    bool mDumpStop;
 
-    /// Keeps track of blocking listeners (semaphores) to be incremented when elements with their corresponding tags are added to the tuple space.
-    std::map<std::string, HANDLE> mListenerRegistry;
+    /// The write-ahead log of the durable tags, which is locked inside the shards.
+    TupleLog mLog;
 
     static TupleSpace* mSingletonPtr;
 };
@@ -0,0 +1,48 @@
+#ifndef _TUPLE_TEMPLATE_HPP_
+#define _TUPLE_TEMPLATE_HPP_
+
+#include <TupleSpace/Tuple.hpp>
+
+/// A Linda template which tuples are matched against, field by field
+class TupleTemplate
+{
+    /***** CONSTRUCTORS / DESTRUCTORS *****/
+    public:
+        /// Constructor which takes a code like the one of a tuple, where a lower case code is an actual value taken from the arguments,
+        /// an upper case code matches any value of that type and '?' matches any field at all
+        TupleTemplate(const char* code, ...);
+
+        /// Destructor which destroys the actual values
+        virtual ~TupleTemplate();
+
+    /***** METHODS *****/
+    public:
+        /// Returns whether a tuple has as many fields as the template and every one of them matches
+        bool matches(const Tuple* t) const;
+
+        /// Returns whether the field at a given index is an actual value rather than a wildcard
+        bool isActual(unsigned int index) const;
+
+        /// Returns a hash of the actual value at a given index, as Tuple::getItemHash() would for a matching tuple
+        std::size_t getItemHash(unsigned int index) const;
+
+        /// Returns the number of fields
+        unsigned int getSize() const;
+
+        /// Returns the code of the fields
+        const std::string& getCode() const;
+
+    /***** ATTRIBUTES *****/
+    protected:
+        /// The code for every field, wildcards included
+        std::string mCode;
+
+        /// The actual values, which are left unset in place of wildcards
+        std::vector<Tuple::Item> mItems;
+
+    private:
+        TupleTemplate(const TupleTemplate&);
+        TupleTemplate& operator=(const TupleTemplate&);
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdlib>
 #include <thread>
 #include <chrono>
 #include <SFML3D/Audio.hpp>
@@ -25,7 +26,10 @@
 #include <glm/gtx/transform.hpp>
 #include <TupleSpace/TupleSpace.hpp>
 #include <TupleSpace/TcpConnectionHandlerAgent.hpp>
+#include <NFE/Benchmark.hpp>
 #include <NFE/CellularAutomaton.hpp>
+#include <NFE/ResultCache.hpp>
+#include <NFE/JobSystem.hpp>
 
 class Player
 {
@@ -398,9 +402,13 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
     std::string host;
     std::string name;
     std::map<std::string, Player*> players;
+    TupleSpace::TagId receivePacket = (tupleSpace != nullptr) ? tupleSpace->intern("RECEIVE_PACKET") : 0;
+    TupleSpace::TagId packetReady = (tupleSpace != nullptr) ? tupleSpace->intern("PACKET_READY") : 0;
     std::vector<Bullet*> bullets;
     std::vector<std::string> peers;
     std::vector<sf3d::Packet*> packets;
+    std::vector<Tuple*> receptions;
+    std::vector<Tuple*> tuples;
     std::vector<std::pair<sf3d::Text*, float>> texts;
     std::vector<std::pair<sf3d::Sound*, sf3d::SoundBuffer*>> hurtSounds;
     sf3d::Sound* landSound = nullptr;
@@ -412,8 +420,8 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
     sf3d::Image* cellsImage = nullptr;
     sf3d::Texture* cellsTexture = nullptr;
     sf3d::Sprite* cellsSprite = nullptr;
+    std::future<sf3d::Image*> cellsJob;
     TcpConnectionHandlerAgent* agent = nullptr;
-    NFE::CellularAutomaton* cells = nullptr;
     unsigned char* maze = nullptr;
     bool role = false;
     bool jump = false;
@@ -1032,9 +1040,12 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
 
         if (agent != nullptr)
         {
-            Tuple* reception = tupleSpace->get("RECEIVE_PACKET");
-            while (reception != nullptr)
+            // the whole backlog of the frame is taken under one lock
+            receptions.clear();
+            tupleSpace->drain(receivePacket, receptions);
+            for (std::size_t r = 0; r != receptions.size(); ++r)
             {
+                Tuple* reception = receptions[r];
                 bool omit = false;
                 sf3d::Packet* packet = static_cast<sf3d::Packet*>(reception->getItemAsVoid(0));
                 std::string message = std::string(static_cast<const char*>(packet->getData()), packet->getDataSize());
@@ -1408,7 +1419,6 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
                         }
                     }
                 }
-                reception = tupleSpace->get("RECEIVE_PACKET");
             }
             if (announcement)
             {
@@ -1428,19 +1438,23 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
                     packets.push_back(packet);
                 }
             }
-            while (!packets.empty())
+            tuples.clear();
+            for (std::size_t i = 0; i != packets.size(); ++i)
             {
-                Tuple* tuple = new Tuple("v", packets.front());
-                std::string message = std::string(static_cast<const char*>(packets.front()->getData()), packets.front()->getDataSize());
+                tuples.push_back(new Tuple("v", packets[i]));
+                std::string message = std::string(static_cast<const char*>(packets[i]->getData()), packets[i]->getDataSize());
                 message = message.substr(message.find_first_of('\t'));
                 if (message.substr(1).front() != 'R')
                 {
                     std::cout << message << std::endl;
                 }
-                packets.erase(packets.begin());
-                tupleSpace->put("PACKET_READY", tuple);
             }
             packets.clear();
+            for (std::size_t i = tupleSpace->putMany(packetReady, tuples); i < tuples.size(); ++i)
+            {
+                delete static_cast<sf3d::Packet*>(tuples[i]->getItemAsVoid(0));
+                delete tuples[i];
+            }
         }
 
         if (!victim.empty())
@@ -1450,20 +1464,25 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
             {
                 players[victim]->hit = true;
             }
-            if ((victim == name) && (cells == nullptr))
+            if ((victim == name) && (cellsSprite == nullptr) && (!cellsJob.valid()))
             {
-                cells = NFE::CellularAutomaton::getConwayGameOfLife(sf3d::Vector2u(25, 25), new NFE::Random());
-                for (int i = 0; i != generations; ++i)
+                cellsJob = NFE::JobSystem::getInstance()->submit([generations]()
                 {
-                    cells->goToNextGeneration();
-                }
-                cellsImage = cells->getImage(false);
-                cellsTexture = new sf3d::Texture();
-                cellsTexture->loadFromImage(*cellsImage);
-                cellsSprite = new sf3d::Sprite(*cellsTexture);
+                    std::shared_ptr<const NFE::ResultCache::Result> cells = NFE::ResultCache::getInstance()->run("conway", &NFE::CellularAutomaton::getConwayGameOfLife, sf3d::Vector2u(25, 25), 0, generations);
+                    return new sf3d::Image(cells->getImage(false));
+                });
             }
         }
 
+        if (NFE::JobSystem::isReady(cellsJob))
+        {
+            // only the texture upload is left to the frame
+            cellsImage = cellsJob.get();
+            cellsTexture = new sf3d::Texture();
+            cellsTexture->loadFromImage(*cellsImage);
+            cellsSprite = new sf3d::Sprite(*cellsTexture);
+        }
+
         if (list <= 0.0f)
         {
             if ((sf3d::Keyboard::isKeyPressed(sf3d::Keyboard::Key::Tab)) && (focus))
@@ -1499,7 +1518,11 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
         std::string message = std::string(static_cast<const char*>(packet->getData()), packet->getDataSize());
         message = message.substr(message.find_first_of('\t'));
         std::cout << message << std::endl;
-        tupleSpace->put("PACKET_READY", tuple);
+        if (!tupleSpace->put(packetReady, tuple))
+        {
+            delete packet;
+            delete tuple;
+        }
     }
 
     for (int i = 0; i != texts.size(); ++i)
@@ -1535,6 +1558,11 @@ int run(TupleSpace* tupleSpace, sf3d::Font& font, sf3d::RenderWindow& window, sf
 
     //delete agent;
 
+    if (cellsJob.valid())
+    {
+        delete cellsJob.get();
+    }
+
     return result;
 }
 
@@ -1559,6 +1587,16 @@ int main(int argc, char** argv)
     if (arguments.size() > 1)
     {
         tupleSpace = new TupleSpace();
+        // the receive agent feeds the game loop and the game loop feeds the send agent, one thread on each side
+        // a stalled game loop holds the receive agent back rather than letting packets pile up,
+        // but a stalled send agent must not stall the frame, so the game loop drops what does not fit
+        tupleSpace->registerTag("RECEIVE_PACKET", TupleRing::SPSC, 4096, TupleSpace::BLOCK);
+        tupleSpace->registerTag("PACKET_READY", TupleRing::SPSC, 4096, TupleSpace::FAIL);
+        // CRNLTL_METRICS names a file to append tuple space metrics to every second, or stdout when empty
+        if (std::getenv("CRNLTL_METRICS") != nullptr)
+        {
+            tupleSpace->setMetricsDump(std::string(std::getenv("CRNLTL_METRICS")), std::chrono::milliseconds(1000));
+        }
     }
     if (tupleSpace != nullptr)
     {
@@ -1584,17 +1622,15 @@ int main(int argc, char** argv)
         std::cout << "host disconnected" << std::endl;
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    // CRNLTL_BENCHMARK times the automata on the offline path, next to the sample it renders
+    if ((tupleSpace == nullptr) && (std::getenv("CRNLTL_BENCHMARK") != nullptr))
+    {
+        NFE::bench::compareConway(std::cout);
+    }
     if (tupleSpace == nullptr)
     {
-        NFE::CellularAutomaton* cells = NFE::CellularAutomaton::getConwayGameOfLife(sf3d::Vector2u(25, 25), new NFE::Random());
-        for (int i = 0; i != 50; ++i)
-        {
-            cells->goToNextGeneration();
-        }
-        sf3d::Image* image = cells->getImage(false);
-        image->saveToFile("cells.png");
-        delete cells;
-        delete image;
+        std::shared_ptr<const NFE::ResultCache::Result> cells = NFE::ResultCache::getInstance()->run("conway", &NFE::CellularAutomaton::getConwayGameOfLife, sf3d::Vector2u(25, 25), 0, 50);
+        cells->getImage(false).saveToFile("cells.png");
     }
     return result;
 }
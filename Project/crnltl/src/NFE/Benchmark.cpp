@@ -0,0 +1,60 @@
+#include <NFE/Benchmark.hpp>
+#include <NFE/BasicCellularAutomaton.hpp>
+#include <NFE/CellularAutomaton.hpp>
+#include <chrono>
+#include <utility>
+
+double NFE::bench::timeGenerations(const std::function<void()>& step, unsigned int generations, unsigned int rounds)
+{
+    double best = 0.0;
+    for (unsigned int i = 0; i != rounds; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned int j = 0; j != generations; ++j)
+        {
+            step();
+        }
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count()/static_cast<double>(generations);
+        if ((i == 0) || (time < best))
+        {
+            best = time;
+        }
+    }
+    return best;
+}
+
+void NFE::bench::compareConway(std::ostream& output)
+{
+    const sf3d::Vector2u size(200, 150);
+    const unsigned int generations = 40;
+    Random random(2);
+    CellularAutomaton* automaton = CellularAutomaton::getConwayGameOfLife(size, &random);
+    BasicConwayGameOfLife kernel;
+    ArrayBoard board(size);
+    ArrayBoard boardOther(size);
+    automaton->setCellReusabilityPolicy(false);
+    automaton->setCascadeStateMapPolicy(false);
+    for (unsigned int x = 0; x != size.x; ++x)
+    {
+        for (unsigned int y = 0; y != size.y; ++y)
+        {
+            board.getCell(x, y) = *automaton->getCells()->getUnit(sf3d::Vector2u(x, y))->getPayload();
+        }
+    }
+    double dynamic = timeGenerations([automaton]() {automaton->goToNextGeneration();}, generations, 1);
+    double basic = timeGenerations([&]() {kernel.step(board, boardOther); std::swap(board, boardOther);}, generations, 1);
+    unsigned int mismatches = 0;
+    for (unsigned int x = 0; x != size.x; ++x)
+    {
+        for (unsigned int y = 0; y != size.y; ++y)
+        {
+            const Cell* cell = automaton->getCells()->getUnit(sf3d::Vector2u(x, y))->getPayload();
+            if ((cell->getState() != board.getCell(x, y).getState()) || (cell->getLife() != board.getCell(x, y).getLife()))
+            {
+                ++mismatches;
+            }
+        }
+    }
+    output << "conway " << size.x << "x" << size.y << " after " << generations << " generations: " << mismatches << " mismatched cells, dynamic " << dynamic << " ms, basic " << basic << " ms per generation" << std::endl;
+    delete automaton;
+}
@@ -0,0 +1,148 @@
+#include <NFE/CellFile.hpp>
+
+namespace
+{
+    const std::uint64_t HEADER_SIZE = 4*sizeof(std::uint32_t);
+}
+
+NFE::CellFile::CellFile()
+{
+
+}
+
+NFE::CellFile::~CellFile()
+{
+    close();
+}
+
+bool NFE::CellFile::create(const std::string& path, const sf3d::Vector2u& size)
+{
+    close();
+    if (!file.create(path,HEADER_SIZE+(static_cast<std::uint64_t>(size.x)*size.y*2*sizeof(std::uint32_t))))
+    {
+        return false;
+    }
+    std::uint32_t* header = reinterpret_cast<std::uint32_t*>(file.getData());
+    header[0] = MAGIC;
+    header[1] = VERSION;
+    header[2] = size.x;
+    header[3] = size.y;
+    this->size = size;
+    return true;
+}
+
+bool NFE::CellFile::open(const std::string& path, bool writable)
+{
+    close();
+    if (!file.open(path,writable))
+    {
+        return false;
+    }
+    if (file.getSize() < HEADER_SIZE)
+    {
+        close();
+        return false;
+    }
+    const std::uint32_t* header = reinterpret_cast<const std::uint32_t*>(file.getData());
+    if ((header[0] != MAGIC) || (header[1] != VERSION) || (file.getSize() != HEADER_SIZE+(static_cast<std::uint64_t>(header[2])*header[3]*2*sizeof(std::uint32_t))))
+    {
+        close();
+        return false;
+    }
+    size.x = header[2];
+    size.y = header[3];
+    return true;
+}
+
+void NFE::CellFile::close()
+{
+    file.close();
+    size = sf3d::Vector2u();
+}
+
+bool NFE::CellFile::flush()
+{
+    return file.flush();
+}
+
+void NFE::CellFile::advise(unsigned int row, unsigned int count, MappedFile::Advice advice) const
+{
+    if ((count == 0) || (row >= size.y))
+    {
+        return;
+    }
+    file.advise(getRowOffset(row),getRowOffset(row+count)-getRowOffset(row),advice);
+}
+
+bool NFE::CellFile::isOpen() const
+{
+    return file.isOpen();
+}
+
+bool NFE::CellFile::isWritable() const
+{
+    return file.isWritable();
+}
+
+const sf3d::Vector2u& NFE::CellFile::getSize() const
+{
+    return size;
+}
+
+std::uint32_t* NFE::CellFile::getRow(unsigned int row) const
+{
+    if ((file.getData() == nullptr) || (row >= size.y))
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<std::uint32_t*>(file.getData()+getRowOffset(row));
+}
+
+bool NFE::CellFile::store(const CellularAutomaton::Cells* cells)
+{
+    if ((!isWritable()) || (cells->getSize().x != size.x) || (cells->getSize().y != size.y))
+    {
+        return false;
+    }
+    advise(0,size.y,MappedFile::SEQUENTIAL);
+    const CellularAutomaton::Cell* cell;
+    std::uint32_t* records;
+    for (unsigned int y = 0; y != size.y; ++y)
+    {
+        records = getRow(y);
+        for (unsigned int x = 0; x != size.x; ++x)
+        {
+            cell = cells->getUnit(sf3d::Vector2u(x,y))->getPayload();
+            records[x*2] = cell->getState();
+            records[(x*2)+1] = cell->getLife();
+        }
+    }
+    return true;
+}
+
+bool NFE::CellFile::load(CellularAutomaton::Cells* cells) const
+{
+    if ((!isOpen()) || (cells->getSize().x != size.x) || (cells->getSize().y != size.y))
+    {
+        return false;
+    }
+    advise(0,size.y,MappedFile::SEQUENTIAL);
+    CellularAutomaton::Cell* cell;
+    const std::uint32_t* records;
+    for (unsigned int y = 0; y != size.y; ++y)
+    {
+        records = getRow(y);
+        for (unsigned int x = 0; x != size.x; ++x)
+        {
+            cell = cells->getUnit(sf3d::Vector2u(x,y))->getPayload();
+            cell->setState(records[x*2]);
+            cell->setLife(records[(x*2)+1]);
+        }
+    }
+    return true;
+}
+
+std::uint64_t NFE::CellFile::getRowOffset(unsigned int row) const
+{
+    return HEADER_SIZE+(static_cast<std::uint64_t>(row)*size.x*2*sizeof(std::uint32_t));
+}
@@ -1,43 +1,21 @@
 #include <NFE/CellularAutomaton.hpp>
+#include <NFE/CellFile.hpp>
+#include <limits>
 #include <set>
 
-NFE::CellularAutomaton::Cell::Cell(unsigned int state, unsigned int life) :
-    state(state),
-    life(life)
-{
-
-}
-
-NFE::CellularAutomaton::Cell::~Cell()
-{
-
-}
-
-unsigned int NFE::CellularAutomaton::Cell::getState() const
-{
-    return state;
-}
-
-void NFE::CellularAutomaton::Cell::setState(unsigned int state)
-{
-    this->state = state;
-}
-
-unsigned int NFE::CellularAutomaton::Cell::getLife() const
-{
-    return life;
-}
-
-void NFE::CellularAutomaton::Cell::setLife(unsigned int life)
-{
-    this->life = life;
-}
-
 NFE::CellularAutomaton::CellularAutomaton() :
     cells(nullptr),
     cascadeTarget(nullptr),
     generationCount(0),
-    generationLoop(1)
+    generationLoop(1),
+    snapshotHeld(false),
+    stateHash(0),
+    cycleHistory(0),
+    cyclePhase(0),
+    cycleRulesVersion(0),
+    publication(false),
+    generationPool(std::make_shared<GenerationPool>()),
+    generationNumber(0)
 {
     create(sf3d::Vector2u());
 }
@@ -46,7 +24,15 @@ NFE::CellularAutomaton::CellularAutomaton(const sf3d::Vector2u& size) :
     cells(nullptr),
     cascadeTarget(nullptr),
     generationCount(0),
-    generationLoop(1)
+    generationLoop(1),
+    snapshotHeld(false),
+    stateHash(0),
+    cycleHistory(0),
+    cyclePhase(0),
+    cycleRulesVersion(0),
+    publication(false),
+    generationPool(std::make_shared<GenerationPool>()),
+    generationNumber(0)
 {
     create(size);
 }
@@ -57,13 +43,25 @@ NFE::CellularAutomaton::CellularAutomaton(const sf3d::Vector2u& size, unsigned i
     cascadeStateMapPolicy(false),
     cellReusabilityPolicy(false),
     generationCount(0),
-    generationLoop(1)
+    generationLoop(1),
+    snapshotHeld(false),
+    stateHash(0),
+    cycleHistory(0),
+    cyclePhase(0),
+    cycleRulesVersion(0),
+    publication(false),
+    generationPool(std::make_shared<GenerationPool>()),
+    generationNumber(0)
 {
     create(size,states,random);
 }
 
 NFE::CellularAutomaton::~CellularAutomaton()
 {
+    stateLifeWatcher.reset();
+    transitionWatcher.reset();
+    neighborhoodsWatcher.reset();
+    neighborhoodRadiusWatcher.reset();
     delete rules;
     delete cells;
 }
@@ -75,11 +73,59 @@ void NFE::CellularAutomaton::initialize(const sf3d::Vector2u& size)
     rules = new Rules();
     //rules->emplace<bool,LIFE_RESET_RULE>(true);
     rules->emplace<StateLife,STATE_LIFE_RULE>([](const Cell& cell, unsigned int state){return (state==cell.getState());});
+    stateLifeDefault = rules->get<StateLife,STATE_LIFE_RULE>();
     rules->emplace<Transition,TRANSITION_RULE>([](const Cell&,const Neighbors&){return 0;});
     rules->emplace<Neighborhoods,NEIGHBORHOODS_RULE>(Neighborhoods());
     rules->emplace<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>(NeighborhoodRadius());
     rules->emplace<CascadeStateMap,OUTBOUND_CASCADE_STATE_MAP_RULE>(CascadeStateMap());
     rules->emplace<CascadeStateMap,INBOUND_CASCADE_STATE_MAP_RULE>(CascadeStateMap());
+    stateLifeWatcher = rules->getWatcher<StateLife,STATE_LIFE_RULE>();
+    transitionWatcher = rules->getWatcher<Transition,TRANSITION_RULE>();
+    neighborhoodsWatcher = rules->getWatcher<Neighborhoods,NEIGHBORHOODS_RULE>();
+    neighborhoodRadiusWatcher = rules->getWatcher<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
+    stateLifeWatcher->triggerChanges();
+    transitionWatcher->triggerChanges();
+    neighborhoodsWatcher->triggerChanges();
+    neighborhoodRadiusWatcher->triggerChanges();
+    takeSnapshot();
+    resetCycle();
+}
+
+void NFE::CellularAutomaton::takeSnapshot()
+{
+    bool compile = false;
+    if (stateLifeWatcher->hasBeenChanged())
+    {
+        snapshot.stateLife = stateLifeWatcher->get();
+    }
+    if (transitionWatcher->hasBeenChanged())
+    {
+        snapshot.transition = transitionWatcher->get();
+    }
+    if (neighborhoodsWatcher->hasBeenChanged())
+    {
+        snapshot.neighborhoods = neighborhoodsWatcher->get();
+        compile = true;
+    }
+    if (neighborhoodRadiusWatcher->hasBeenChanged())
+    {
+        snapshot.neighborhoodRadius = neighborhoodRadiusWatcher->get();
+        compile = true;
+    }
+    // the rules are only ever replaced through set(), so the pointers into the radius map stay valid until a watcher sees a new one
+    if (compile)
+    {
+        NeighborhoodRadius::const_iterator iter;
+        snapshot.stateRadius.assign(snapshot.neighborhoods->size(),nullptr);
+        for (unsigned int i = 0; i != snapshot.stateRadius.size(); ++i)
+        {
+            iter = snapshot.neighborhoodRadius->find(i);
+            if (iter != snapshot.neighborhoodRadius->end())
+            {
+                snapshot.stateRadius[i] = &iter->second;
+            }
+        }
+    }
 }
 
 void NFE::CellularAutomaton::create(const sf3d::Vector2u& size)
@@ -92,6 +138,11 @@ void NFE::CellularAutomaton::create(const sf3d::Vector2u& size)
             cells->setUnit(new Cell(0),sf3d::Vector2u(x,y));
         }
     }
+    resetStateHash();
+    if (publication)
+    {
+        publish();
+    }
 }
 
 void NFE::CellularAutomaton::create(const sf3d::Vector2u& size, unsigned int states, Random* random)
@@ -109,37 +160,77 @@ void NFE::CellularAutomaton::create(const sf3d::Vector2u& size, unsigned int sta
             cells->setUnit(new Cell(static_cast<unsigned int>(random->getInt(0,states-1))),sf3d::Vector2u(x,y));
         }
     }
+    resetStateHash();
+    if (publication)
+    {
+        publish();
+    }
 }
 
 void NFE::CellularAutomaton::accomodateNewTransitionRule(Transition transition)
 {
-    Transition temp = *rules->get<Transition,TRANSITION_RULE>();
-    rules->emplace<Transition,TRANSITION_RULE>([=](const Cell& cell, const Neighbors& neighbors){
-                                               unsigned int newState = transition(cell.getState(),neighbors);
-                                               if (newState == cell.getState())
-                                               {
-                                                   return temp(cell,neighbors);
-                                               }
-                                               return newState;
-                                               });
+    TransitionLayer layer;
+    layer.kind = TransitionLayer::TRANSITION;
+    layer.state = 0;
+    layer.transition = transition;
+    accomodate(layer);
 }
 
 void NFE::CellularAutomaton::accomodateNewState(unsigned int newState, Transition transition)
 {
-    Transition temp = *rules->get<Transition,TRANSITION_RULE>();
-    rules->emplace<Transition,TRANSITION_RULE>([=](const Cell& cell, const Neighbors& neighbors){
-                                               if ((cell.getState() != newState) && (getNeighborsOfState(neighbors,newState).empty()))
-                                               {
-                                                   return temp(cell,neighbors);
-                                               }
-                                               return transition(cell,neighbors);
-                                               });
+    TransitionLayer layer;
+    layer.kind = TransitionLayer::STATE;
+    layer.state = newState;
+    layer.transition = transition;
+    accomodate(layer);
+}
+
+void NFE::CellularAutomaton::accomodate(const TransitionLayer& layer)
+{
+    std::shared_ptr<Transition> transition = rules->get<Transition,TRANSITION_RULE>();
+    if (transition != transitionLayered)
+    {
+        // the transition was set from outside since the last layer, so it becomes the new base
+        transitionBase = *transition;
+        transitionLayers.clear();
+    }
+    transitionLayers.push_back(layer);
+    rules->set<Transition,TRANSITION_RULE>(std::make_shared<Transition>(getLayeredTransition(transitionBase,std::make_shared<const TransitionLayers>(transitionLayers))));
+    transitionLayered = rules->get<Transition,TRANSITION_RULE>();
+}
+
+NFE::CellularAutomaton::Transition NFE::CellularAutomaton::getLayeredTransition(const Transition& base, std::shared_ptr<const TransitionLayers> layers)
+{
+    // The latest layer takes precedence, exactly as if each one wrapped the transition before it.
+    return [=](const Cell& cell, const Neighbors& neighbors){
+               unsigned int state;
+               for (TransitionLayers::const_reverse_iterator iter = layers->rbegin(); iter != layers->rend(); ++iter)
+               {
+                   if (iter->kind == TransitionLayer::STATE)
+                   {
+                       if ((cell.getState() == iter->state) || (hasNeighborsOfState(neighbors,iter->state)))
+                       {
+                           return iter->transition(cell,neighbors);
+                       }
+                   }
+                   else
+                   {
+                       state = iter->transition(cell.getState(),neighbors);
+                       if (state != cell.getState())
+                       {
+                           return state;
+                       }
+                   }
+               }
+               return base(cell,neighbors);
+               };
 }
 
 void NFE::CellularAutomaton::goToNextGeneration()
 {
     bool cascade = false;
     ++generationCount;
+    ++generationNumber;
     if (generationLoop != 0)
     {
         if (generationCount%generationLoop == 0)
@@ -156,13 +247,161 @@ void NFE::CellularAutomaton::goToNextGeneration()
     }
     if ((generationCount != 0) || (cascadeTarget == nullptr))
     {
-        Cells* generation = getNextGeneration();
-        update(generation,cascade);
-        if (!cellReusabilityPolicy)
+        if (!replayCycle())
+        {
+            Cells* generation = getNextGeneration();
+            update(generation,cascade);
+            if (!cellReusabilityPolicy)
+            {
+                delete generation;
+            }
+            recordCycle();
+        }
+    }
+    if (publication)
+    {
+        publish();
+    }
+}
+
+void NFE::CellularAutomaton::advance(unsigned int generations)
+{
+    for (; generations != 0; --generations)
+    {
+        if ((!cycle.empty()) && (cascadeTarget == nullptr) && (getRulesVersion() == cycleRulesVersion))
+        {
+            takeSnapshot();
+            if (snapshot.stateLife == stateLifeDefault)
+            {
+                skipCycle(generations);
+                return;
+            }
+        }
+        goToNextGeneration();
+    }
+}
+
+bool NFE::CellularAutomaton::goToNextGeneration(const CellFile& source, CellFile& target, unsigned int band)
+{
+    // Steps a board stored in a state file one horizontal band at a time. Each band is copied into a
+    // window board together with reach rows of halo on both sides, fetched from the opposite edge of the
+    // board for a TORUS, and only the rows of the band itself are written to the target. Cascades and
+    // the generation loop are not applied, and this automaton's own cells are left untouched.
+    // The neighbors are gathered as getNeighbors() does, without its overrides.
+    if ((!source.isOpen()) || (!target.isWritable()) || (band == 0))
+    {
+        return false;
+    }
+    if ((source.getSize().x != target.getSize().x) || (source.getSize().y != target.getSize().y))
+    {
+        return false;
+    }
+    Topology topology = cells->getTopology();
+    if ((topology != Cells::TORUS) && (topology != Cells::PLANE))
+    {
+        return false;
+    }
+    int width = static_cast<int>(source.getSize().x);
+    int height = static_cast<int>(source.getSize().y);
+    int reach = static_cast<int>(getNeighborhoodReach());
+    std::map<int,Cells*> geometries;
+    std::map<int,Cells*>::iterator iter;
+    Cells* geometry;
+    ArrayBoard window;
+    ArrayBoard generation;
+    DynamicTransition transition;
+    DynamicLife life;
+    BandStencil stencil;
+    const std::uint32_t* records;
+    std::uint32_t* recordsOther;
+    int top;
+    int bottom;
+    int rows;
+    int row;
+    takeSnapshot();
+    transition.transition = snapshot.transition.get();
+    life.stateLife = snapshot.stateLife.get();
+    stencil.automaton = this;
+    source.advise(0,source.getSize().y,MappedFile::SEQUENTIAL);
+    target.advise(0,target.getSize().y,MappedFile::SEQUENTIAL);
+    for (int y = 0; y < height; y += static_cast<int>(band))
+    {
+        rows = std::min(static_cast<int>(band),height-y);
+        if (topology == Cells::TORUS)
+        {
+            top = y-reach;
+            bottom = y+rows+reach;
+        }
+        else
+        {
+            top = std::max(0,y-reach);
+            bottom = std::min(height,y+rows+reach);
+        }
+        if (y+rows < height)
+        {
+            source.advise(static_cast<unsigned int>(y+rows),std::min(static_cast<int>(band),height-(y+rows)),MappedFile::WILL_NEED);
+        }
+        // geometries are kept per height until the end, so that neighborhood caches keyed by grid never see a recycled address
+        iter = geometries.find(bottom-top);
+        if (iter == geometries.end())
+        {
+            geometry = new Cells(sf3d::Vector2u(width,bottom-top),true,topology);
+            geometries[bottom-top] = geometry;
+        }
+        else
+        {
+            geometry = iter->second;
+        }
+        // the boards are only reallocated when the height of the band changes, at the edges of a PLANE or for the last band
+        if (window.getSize() != geometry->getSize())
+        {
+            window = ArrayBoard(geometry->getSize());
+            generation = ArrayBoard(geometry->getSize());
+        }
+        for (int i = 0; i != bottom-top; ++i)
+        {
+            row = (((top+i)%height)+height)%height;
+            records = source.getRow(static_cast<unsigned int>(row));
+            for (int x = 0; x != width; ++x)
+            {
+                Cell& cell = window.getCell(x,i);
+                cell.setState(records[x*2]);
+                cell.setLife(records[(x*2)+1]);
+            }
+        }
+        stencil.geometry = geometry;
+        stencil.first = static_cast<std::size_t>(y-top);
+        stencil.last = stencil.first+rows;
+        BandKernel(transition,life,stencil).step(window,generation);
+        for (int i = y-top; i != (y-top)+rows; ++i)
+        {
+            recordsOther = target.getRow(static_cast<unsigned int>(top+i));
+            for (int x = 0; x != width; ++x)
+            {
+                const Cell& cell = generation.getCell(x,i);
+                recordsOther[x*2] = cell.getState();
+                recordsOther[(x*2)+1] = cell.getLife();
+            }
+        }
+        if (top > 0)
+        {
+            source.advise(0,static_cast<unsigned int>(top),MappedFile::DONT_NEED);
+        }
+    }
+    for (iter = geometries.begin(); iter != geometries.end(); ++iter)
+    {
+        delete iter->second;
+    }
+    std::shared_ptr<Neighborhoods> neighborhoods = rules->get<Neighborhoods,NEIGHBORHOODS_RULE>();
+    for (unsigned int i = 0; i != neighborhoods->size(); ++i)
+    {
+        if ((neighborhoods->at(i) != nullptr) && (neighborhoods->at(i)->getCache()))
         {
-            delete generation;
+            neighborhoods->at(i)->setCache(false);
+            neighborhoods->at(i)->setCache(true);
         }
     }
+    return true;
 }
 
 void NFE::CellularAutomaton::setNeighborhoodStyle(Neighborhood::Style style)
@@ -177,6 +416,7 @@ void NFE::CellularAutomaton::setNeighborhoodStyle(Neighborhood::Style style)
             neighborhood->setStyle(style);
         }
     }
+    resetCycle();
 }
 
 void NFE::CellularAutomaton::setNeighborhoodCache(bool cache)
@@ -196,6 +436,7 @@ void NFE::CellularAutomaton::setNeighborhoodCache(bool cache)
 void NFE::CellularAutomaton::setTopology(Topology topology)
 {
     cells->setTopology(topology);
+    resetCycle();
 }
 
 NFE::CellularAutomaton::Cells::Topology NFE::CellularAutomaton::getTopology() const
@@ -206,6 +447,7 @@ NFE::CellularAutomaton::Cells::Topology NFE::CellularAutomaton::getTopology() co
 void NFE::CellularAutomaton::setCellReusabilityPolicy(bool policy)
 {
     cellReusabilityPolicy = policy;
+    resetCycle();
 }
 
 bool NFE::CellularAutomaton::getCellReusabilityPolicy() const
@@ -238,6 +480,40 @@ void NFE::CellularAutomaton::setGenerationLoop(unsigned int generationLoop)
     this->generationLoop = generationLoop;
 }
 
+void NFE::CellularAutomaton::setCycleDetection(unsigned int history)
+{
+    cycleHistory = history;
+    resetCycle();
+}
+
+unsigned int NFE::CellularAutomaton::getCycleDetection() const
+{
+    return cycleHistory;
+}
+
+unsigned int NFE::CellularAutomaton::getPeriod() const
+{
+    return cycle.size();
+}
+
+std::uint64_t NFE::CellularAutomaton::getStateHash(bool life) const
+{
+    if (!life)
+    {
+        return stateHash;
+    }
+    // lives change on nearly every cell each generation, so their part is folded in on demand
+    std::uint64_t hash = stateHash;
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != cells->getSize().y; ++y)
+        {
+            hash ^= getLifeKey(sf3d::Vector2u(x,y),cells->getUnit(sf3d::Vector2u(x,y))->getPayload()->getLife());
+        }
+    }
+    return hash;
+}
+
 unsigned int NFE::CellularAutomaton::getGenerationLoop() const
 {
     return generationLoop;
@@ -248,6 +524,36 @@ unsigned int NFE::CellularAutomaton::getGenerationCount() const
     return generationCount;
 }
 
+void NFE::CellularAutomaton::setPublication(bool publication)
+{
+    this->publication = publication;
+    if (publication)
+    {
+        publish();
+    }
+}
+
+bool NFE::CellularAutomaton::getPublication() const
+{
+    return publication;
+}
+
+std::uint64_t NFE::CellularAutomaton::getGenerationNumber() const
+{
+    return generationNumber;
+}
+
+std::shared_ptr<const NFE::CellularAutomaton::Generation> NFE::CellularAutomaton::getPublished() const
+{
+    // safe from any thread, the copy is null until publication was turned on
+    return publications.get<const Generation,PUBLISHED_GENERATION>();
+}
+
+NFE::CellularAutomaton::PublishedGenerationSlot::WatcherTypePtr NFE::CellularAutomaton::getPublicationWatcher()
+{
+    return publications.getWatcher<const Generation,PUBLISHED_GENERATION>();
+}
+
 unsigned int NFE::CellularAutomaton::getStateCount() const
 {
     unsigned int stateCount;
@@ -280,6 +586,21 @@ unsigned int NFE::CellularAutomaton::getCellsOfStateCount(unsigned int state) co
     return result;
 }
 
+unsigned int NFE::CellularAutomaton::getNeighborhoodReach() const
+{
+    int reach = 0;
+    std::shared_ptr<NeighborhoodRadius> radius = rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
+    for (NeighborhoodRadius::const_iterator iter1 = radius->begin(); iter1 != radius->end(); ++iter1)
+    {
+        for (StateRadius::const_iterator iter2 = iter1->second.begin(); iter2 != iter1->second.end(); ++iter2)
+        {
+            reach = std::max(reach,static_cast<int>(std::round(fabsf(iter2->second.x))));
+            reach = std::max(reach,static_cast<int>(std::round(fabsf(iter2->second.y))));
+        }
+    }
+    return static_cast<unsigned int>(reach);
+}
+
 const NFE::CellularAutomaton::Cells* NFE::CellularAutomaton::getCells() const
 {
     return cells;
@@ -292,11 +613,7 @@ sf3d::Image* NFE::CellularAutomaton::getLifeImage(const sf3d::Color& old, const
 
 sf3d::Image* NFE::CellularAutomaton::getImage(bool life) const
 {
-    if (life)
-    {
-        return cells->getImage([](const Cells::Unit* element){return mixColors(sf3d::Color::Black,getColorFromKey(static_cast<int>(element->getPayload()->getState()+1)),1.0f/static_cast<float>(element->getPayload()->getLife()+1),true);});
-    }
-    return cells->getImage([](const Cells::Unit* element){return getColorFromKey(static_cast<int>(element->getPayload()->getState()+1));});
+    return cells->getImage([=](const Cells::Unit* element){return getCellColor(*element->getPayload(),life);});
 }
 
 std::string NFE::CellularAutomaton::getRulesString()
@@ -312,7 +629,9 @@ NFE::CellularAutomaton::Rules* NFE::CellularAutomaton::getRules() const
 NFE::CellularAutomaton::Cells* NFE::CellularAutomaton::getNextGeneration()
 {
     Neighbors neighbors = Neighbors();
-    std::shared_ptr<Transition> transition = rules->get<Transition,TRANSITION_RULE>();
+    takeSnapshot();
+    snapshotHeld = true;
+    Kernel kernel = getKernel();
     Cells* generation;
     if (cellReusabilityPolicy)
     {
@@ -320,58 +639,68 @@ NFE::CellularAutomaton::Cells* NFE::CellularAutomaton::getNextGeneration()
     }
     else
     {
-        generation = new Cells(cells->getSize());
-        generation->setTopology(cells->getTopology());
+        generation = new Cells(cells->getSize(),true,cells->getTopology());
     }
-    Cell* cell;
     sf3d::Vector2u index;
     unsigned int state;
-    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    for (unsigned int i = 0; i != cells->getCapacity(); ++i)
     {
-        for (unsigned int y = 0; y != cells->getSize().y; ++y)
+        if (!cells->getIndex(i,index))
+        {
+            continue;
+        }
+        if (kernel.getNextState(*cells,index,neighbors,state))
         {
-            index.x = x;
-            index.y = y;
-            cell = cells->getUnit(index)->getPayload();
-            if (getNeighbors(cell,index,neighbors))
+            if (cellReusabilityPolicy)
             {
-                state = (*transition)(*cell,neighbors);
-                if (cellReusabilityPolicy)
-                {
-                    update(generation->getUnit(index)->getPayload(),state);
-                }
-                else
-                {
-                    generation->setUnit(new Cell(state),index);
-                }
+                update(kernel,generation->getUnit(index)->getPayload(),index,state);
+            }
+            else
+            {
+                generation->setUnit(new Cell(state),index);
             }
-            neighbors.clear();
         }
     }
+    snapshotHeld = false;
     return generation;
 }
 
+NFE::CellularAutomaton::Kernel NFE::CellularAutomaton::getKernel()
+{
+    DynamicTransition transition;
+    DynamicLife life;
+    DynamicStencil stencil;
+    transition.transition = snapshot.transition.get();
+    life.stateLife = snapshot.stateLife.get();
+    stencil.automaton = this;
+    return Kernel(transition,life,stencil);
+}
+
 bool NFE::CellularAutomaton::getNeighbors(const Cell* cell, const sf3d::Vector2u& index, Neighbors& neighbors)
 {
     Rule rule;
     Cells::Unit* unit;
     Neighborhood* neighborhood;
-    NeighborhoodRadius::iterator iter1;
-    StateRadius::iterator iter2;
+    const StateRadius* stateRadius;
+    StateRadius::const_iterator iter2;
     Rule::iterator iter3;
     unsigned int stateOther;
     unsigned int state = cell->getState();
-    std::shared_ptr<NeighborhoodRadius> radius = rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
-    std::shared_ptr<Neighborhoods> neighborhoods = rules->get<Neighborhoods,NEIGHBORHOODS_RULE>();
-    for (unsigned int i = 0; i != neighborhoods->size(); ++i)
+    // a generation keeps the rules it started with, a call from outside one sees the latest
+    if (!snapshotHeld)
     {
-        iter1 = radius->find(i);
-        if (iter1 != radius->end())
+        takeSnapshot();
+    }
+    const Neighborhoods& neighborhoods = *snapshot.neighborhoods;
+    for (unsigned int i = 0; i != snapshot.stateRadius.size(); ++i)
+    {
+        stateRadius = snapshot.stateRadius[i];
+        if (stateRadius != nullptr)
         {
-            iter2 = iter1->second.find(state);
-            if (iter2 != iter1->second.end())
+            iter2 = stateRadius->find(state);
+            if (iter2 != stateRadius->end())
             {
-                neighborhood = neighborhoods->at(i);
+                neighborhood = neighborhoods[i];
                 if (neighborhood != nullptr)
                 {
                     if (neighborhood->update(cells,index,iter2->second))
@@ -407,6 +736,69 @@ bool NFE::CellularAutomaton::getNeighbors(const Cell* cell, const sf3d::Vector2u
     return true;
 }
 
+bool NFE::CellularAutomaton::getNeighbors(const ArrayBoard& band, const Cells* geometry, const sf3d::Vector2u& index, const Cell& cell, Neighbors& neighbors)
+{
+    Rule rule;
+    Neighborhood* neighborhood;
+    const StateRadius* stateRadius;
+    StateRadius::const_iterator iter2;
+    Rule::iterator iter3;
+    sf3d::Vector2u position;
+    unsigned int stateOther;
+    unsigned int state = cell.getState();
+    const Neighborhoods& neighborhoods = *snapshot.neighborhoods;
+    for (unsigned int i = 0; i != snapshot.stateRadius.size(); ++i)
+    {
+        stateRadius = snapshot.stateRadius[i];
+        if (stateRadius != nullptr)
+        {
+            iter2 = stateRadius->find(state);
+            if (iter2 != stateRadius->end())
+            {
+                neighborhood = neighborhoods[i];
+                if (neighborhood != nullptr)
+                {
+                    if (neighborhood->update(geometry,index,iter2->second))
+                    {
+                        for (unsigned int j = 0; j != neighborhood->getSize(); ++j)
+                        {
+                            // the same mapping as Grid::getUnit(neighborhood,j), where the geometry stands in for the band
+                            if (neighborhood->getRelativity())
+                            {
+                                position = geometry->getAbsoluteIndex(sf3d::Vector2i(neighborhood->getOrigin())+neighborhood->getContents()[j]);
+                            }
+                            else
+                            {
+                                position = sf3d::Vector2u(neighborhood->getContents()[j]);
+                            }
+                            if ((position.x >= band.getSize().x) || (position.y >= band.getSize().y))
+                            {
+                                continue;
+                            }
+                            stateOther = band.getCell(position.x,position.y).getState();
+                            iter3 = rule.find(stateOther);
+                            if (iter3 == rule.end())
+                            {
+                                rule[stateOther] = 1;
+                            }
+                            else
+                            {
+                                ++iter3->second;
+                            }
+                        }
+                        if (!rule.empty())
+                        {
+                            neighbors[i] = rule;
+                            rule.clear();
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
 sf3d::Color NFE::CellularAutomaton::getColorFromKey(int key)
 {
     int block = powf(2,3);
@@ -425,6 +817,15 @@ sf3d::Color NFE::CellularAutomaton::getColorFromKey(int key)
     return color;
 }
 
+sf3d::Color NFE::CellularAutomaton::getCellColor(const Cell& cell, bool life)
+{
+    if (life)
+    {
+        return mixColors(sf3d::Color::Black,getColorFromKey(static_cast<int>(cell.getState()+1)),1.0f/static_cast<float>(cell.getLife()+1),true);
+    }
+    return getColorFromKey(static_cast<int>(cell.getState()+1));
+}
+
 sf3d::Color NFE::CellularAutomaton::mixColors(const sf3d::Color& color1, const sf3d::Color& color2, float key, bool alpha)
 {
     sf3d::Color color = sf3d::Color::White;
@@ -456,10 +857,9 @@ NFE::CellularAutomaton* NFE::CellularAutomaton::getMorphogenesis(const sf3d::Vec
     }
     Rules* rules = morphogenesis->getRules();
     morphogenesis->setTopology(Cells::Topology::TORUS);
-    rules->get<Neighborhoods,NEIGHBORHOODS_RULE>()->push_back(new Neighborhood(Cells::Neighborhood::Style::MENAECHMUS));
-    rules->get<Neighborhoods,NEIGHBORHOODS_RULE>()->push_back(new Neighborhood(Cells::Neighborhood::Style::MENAECHMUS));
-    rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>()->insert(NeighborhoodRadiusPair(0,{StateRadiusPair(0,activationRange),StateRadiusPair(1,activationRange)}));
-    rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>()->insert(NeighborhoodRadiusPair(1,{StateRadiusPair(0,inhibitionRange),StateRadiusPair(1,inhibitionRange)}));
+    rules->emplace<Neighborhoods,NEIGHBORHOODS_RULE>(Neighborhoods{new Neighborhood(Cells::Neighborhood::Style::MENAECHMUS),new Neighborhood(Cells::Neighborhood::Style::MENAECHMUS)});
+    rules->emplace<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>(NeighborhoodRadius{NeighborhoodRadiusPair(0,{StateRadiusPair(0,activationRange),StateRadiusPair(1,activationRange)}),
+                                                                                   NeighborhoodRadiusPair(1,{StateRadiusPair(0,inhibitionRange),StateRadiusPair(1,inhibitionRange)})});
     rules->emplace<Transition,TRANSITION_RULE>([=](const Cell& cell, const Neighbors& neighbors){
                                                unsigned int activators = 0;
                                                unsigned int inhibitors = 0;
@@ -525,8 +925,8 @@ NFE::CellularAutomaton* NFE::CellularAutomaton::getConwayGameOfLife(const sf3d::
     }
     Rules* rules = life->getRules();
     life->setTopology(Cells::Topology::TORUS);
-    rules->get<Neighborhoods,NEIGHBORHOODS_RULE>()->push_back(new Neighborhood(Cells::Neighborhood::Style::MOORE));
-    rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>()->insert(NeighborhoodRadiusPair(0,{StateRadiusPair(0,sf3d::Vector2f(1.0f,1.0f)),StateRadiusPair(1,sf3d::Vector2f(1.0f,1.0f))}));
+    rules->emplace<Neighborhoods,NEIGHBORHOODS_RULE>(Neighborhoods{new Neighborhood(Cells::Neighborhood::Style::MOORE)});
+    rules->emplace<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>(NeighborhoodRadius{NeighborhoodRadiusPair(0,{StateRadiusPair(0,sf3d::Vector2f(1.0f,1.0f)),StateRadiusPair(1,sf3d::Vector2f(1.0f,1.0f))})});
     rules->emplace<Transition,TRANSITION_RULE>([](const Cell& cell, const Neighbors& neighbors){
                                                unsigned int newState = 0;
                                                Neighbors::const_iterator iter1 = neighbors.find(0);
@@ -561,6 +961,7 @@ NFE::CellularAutomaton::CascadePair NFE::CellularAutomaton::getPoisonedConwayGam
 {
     CellularAutomaton* poison = getConwayGameOfLife(size);
     CellularAutomaton* conway = getConwayGameOfLife(size,random);
+    NeighborhoodRadius radius;
     Rules* rules = conway->getRules();
     std::shared_ptr<Rule> rule = rules->get<CascadeStateMap,OUTBOUND_CASCADE_STATE_MAP_RULE>();
     rule->insert(RulePair(0,0));
@@ -570,7 +971,9 @@ NFE::CellularAutomaton::CascadePair NFE::CellularAutomaton::getPoisonedConwayGam
     rule->insert(RulePair(0,0));
     rule->insert(RulePair(1,1));
     rule->insert(RulePair(2,2));
-    rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>()->at(0).insert(StateRadiusPair(2,sf3d::Vector2f(1.0f,1.0f)));
+    radius = *rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
+    radius.at(0).insert(StateRadiusPair(2,sf3d::Vector2f(1.0f,1.0f)));
+    rules->emplace<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>(radius);
     rules = poison->getRules();
     rule = rules->get<CascadeStateMap,OUTBOUND_CASCADE_STATE_MAP_RULE>();
     rule->insert(RulePair(0,0));
@@ -580,7 +983,9 @@ NFE::CellularAutomaton::CascadePair NFE::CellularAutomaton::getPoisonedConwayGam
     rule->insert(RulePair(0,0));
     rule->insert(RulePair(1,1));
     rule->insert(RulePair(2,2));
-    rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>()->at(0).insert(StateRadiusPair(2,sf3d::Vector2f(1.0f,1.0f)));
+    radius = *rules->get<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
+    radius.at(0).insert(StateRadiusPair(2,sf3d::Vector2f(1.0f,1.0f)));
+    rules->emplace<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>(radius);
     conway->accomodateNewState(2,[](const Cell&,const Neighbors&){return 2u;});
     poison->accomodateNewState(2,[](const Cell&,const Neighbors&){return 2u;});
     poison->accomodateNewTransitionRule([=](const Cell& cell, const Neighbors& neighbors){
@@ -670,6 +1075,18 @@ NFE::CellularAutomaton::Rule NFE::CellularAutomaton::getNeighborsOfState(const N
     return rule;
 }
 
+bool NFE::CellularAutomaton::hasNeighborsOfState(const Neighbors& neighbors, unsigned int state)
+{
+    for (Neighbors::const_iterator iter = neighbors.begin(); iter != neighbors.end(); ++iter)
+    {
+        if (iter->second.find(state) != iter->second.end())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void NFE::CellularAutomaton::freeCascadePairs(const std::vector<CascadePair>& cascadePairs)
 {
     std::set<CellularAutomaton*> uniques;
@@ -691,33 +1108,67 @@ void NFE::CellularAutomaton::update(const Cells* cells, std::shared_ptr<CascadeS
     {
         return;
     }
+    if ((cascadeStateMap->empty()) && (!cascadeStateMapPolicy))
+    {
+        // no cell would be touched, so the cycle being tracked is still valid
+        return;
+    }
+    // The map is compiled to a dense table over the states it names, up to a bound past which the map itself is searched.
+    // A map sending every state to itself, with unmapped states copied as well, reduces to a plain copy of the other board.
+    const unsigned int UNMAPPED = std::numeric_limits<unsigned int>::max();
+    const unsigned int BOUND = 1<<16;
+    std::vector<unsigned int> table;
+    bool identity = true;
+    if (!cascadeStateMap->empty())
+    {
+        table.assign(std::min(cascadeStateMap->rbegin()->first,BOUND-1)+1,UNMAPPED);
+    }
+    for (CascadeStateMap::const_iterator iter = cascadeStateMap->begin(); iter != cascadeStateMap->end(); ++iter)
+    {
+        if (iter->first < table.size())
+        {
+            table[iter->first] = iter->second;
+        }
+        identity = ((identity) && (iter->first == iter->second));
+    }
+    bool copy = ((identity) && (cascadeStateMapPolicy));
     CascadeStateMap::const_iterator iter;
     sf3d::Vector2u index;
     Cell* cell;
     Cell* cellOther;
-    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    unsigned int state;
+    resetCycle();
+    for (unsigned int i = 0; i != this->cells->getCapacity(); ++i)
     {
-        for (unsigned int y = 0; y != cells->getSize().y; ++y)
+        if (!this->cells->getIndex(i,index))
+        {
+            continue;
+        }
+        cell = this->cells->getUnit(index)->getPayload();
+        cellOther = cells->getUnit(index)->getPayload();
+        state = cellOther->getState();
+        if (!copy)
         {
-            index.x = x;
-            index.y = y;
-            cell = this->cells->getUnit(index)->getPayload();
-            cellOther = cells->getUnit(index)->getPayload();
-            iter = cascadeStateMap->find(cellOther->getState());
-            if (iter != cascadeStateMap->end())
+            if (state < table.size())
             {
-                cell->setState(iter->second);
-                cell->setLife(cellOther->getLife());
+                state = table[state];
             }
             else
             {
-                if (cascadeStateMapPolicy)
+                iter = cascadeStateMap->find(state);
+                state = (iter != cascadeStateMap->end())?iter->second:UNMAPPED;
+            }
+            if (state == UNMAPPED)
+            {
+                if (!cascadeStateMapPolicy)
                 {
-                    cell->setState(cellOther->getState());
-                    cell->setLife(cellOther->getLife());
+                    continue;
                 }
+                state = cellOther->getState();
             }
         }
+        setState(cell,index,state);
+        cell->setLife(cellOther->getLife());
     }
 }
 
@@ -731,34 +1182,279 @@ void NFE::CellularAutomaton::update(const Cells* cells, bool cascade)
     {
         return;
     }
+    Kernel kernel = getKernel();
     sf3d::Vector2u index;
     unsigned int state;
     Cell* cell;
+    for (unsigned int i = 0; i != this->cells->getCapacity(); ++i)
+    {
+        if (!this->cells->getIndex(i,index))
+        {
+            continue;
+        }
+        cell = this->cells->getUnit(index)->getPayload();
+        state = cells->getUnit(index)->getPayload()->getState();
+        update(kernel,cell,index,state);
+    }
+}
+
+void NFE::CellularAutomaton::update(Cell* cell, const sf3d::Vector2u& index, unsigned int state)
+{
+    update(getKernel(),cell,index,state);
+}
+
+void NFE::CellularAutomaton::update(const Kernel& kernel, Cell* cell, const sf3d::Vector2u& index, unsigned int state)
+{
+    unsigned int previous = cell->getState();
+    kernel.update(*cell,state);
+    if (cell->getState() != previous)
+    {
+        stateHash ^= getStateKey(index,previous)^getStateKey(index,cell->getState());
+    }
+}
+
+void NFE::CellularAutomaton::setState(const sf3d::Vector2u& index, unsigned int state)
+{
+    Cells::Unit* unit;
+    if ((index.x >= cells->getSize().x) || (index.y >= cells->getSize().y))
+    {
+        return;
+    }
+    unit = cells->getUnit(index);
+    if (unit != nullptr)
+    {
+        setState(unit->getPayload(),index,state);
+    }
+}
+
+void NFE::CellularAutomaton::setState(Cell* cell, const sf3d::Vector2u& index, unsigned int state)
+{
+    if (cell->getState() != state)
+    {
+        stateHash ^= getStateKey(index,cell->getState())^getStateKey(index,state);
+        cell->setState(state);
+    }
+}
+
+void NFE::CellularAutomaton::resetCycle()
+{
+    cyclePhase = 0;
+    cycleRulesVersion = getRulesVersion();
+    cycleFrames.clear();
+    cycleHashes.clear();
+    cycle.clear();
+}
+
+bool NFE::CellularAutomaton::replayCycle()
+{
+    if (cycle.empty())
+    {
+        return false;
+    }
+    if ((cascadeTarget != nullptr) || (getRulesVersion() != cycleRulesVersion))
+    {
+        resetCycle();
+        return false;
+    }
+    // the states repeat, but the life rule still runs on every cell as a real generation would
+    takeSnapshot();
+    Kernel kernel = getKernel();
+    cyclePhase = (cyclePhase+1)%cycle.size();
+    const std::vector<unsigned int>& states = cycle[cyclePhase];
+    unsigned int size = cells->getSize().y;
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != size; ++y)
+        {
+            update(kernel,cells->getUnit(sf3d::Vector2u(x,y))->getPayload(),sf3d::Vector2u(x,y),states[(x*size)+y]);
+        }
+    }
+    return true;
+}
+
+void NFE::CellularAutomaton::recordCycle()
+{
+    // Only boards stepped on their own are tracked, since a cascade feeds in states from another automaton.
+    // The transition is assumed to be deterministic and to depend on the states alone.
+    if ((cycleHistory == 0) || (cascadeTarget != nullptr))
+    {
+        return;
+    }
+    if (getRulesVersion() != cycleRulesVersion)
+    {
+        resetCycle();
+    }
+    std::vector<unsigned int> states = getStates();
+    std::uint64_t hash = stateHash;
+    for (unsigned int i = cycleFrames.size(); i != 0; --i)
+    {
+        if ((cycleHashes[i-1] == hash) && (cycleFrames[i-1] == states))
+        {
+            cycle.assign(cycleFrames.begin()+(i-1),cycleFrames.end());
+            cyclePhase = 0;
+            cycleFrames.clear();
+            cycleHashes.clear();
+            return;
+        }
+    }
+    cycleFrames.push_back(states);
+    cycleHashes.push_back(hash);
+    if (cycleFrames.size() > cycleHistory)
+    {
+        cycleFrames.pop_front();
+        cycleHashes.pop_front();
+    }
+}
+
+void NFE::CellularAutomaton::skipCycle(unsigned int generations)
+{
+    // With the default life rule a cell's life is the number of generations since its state last changed,
+    // which only depends on the cycle, so any number of generations is skipped in a single pass.
+    unsigned int period = cycle.size();
+    unsigned int size = cells->getSize().y;
+    unsigned int window = std::min(generations,period);
+    unsigned int offset;
+    unsigned int change;
+    Cell* cell;
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != size; ++y)
+        {
+            offset = (x*size)+y;
+            cell = cells->getUnit(sf3d::Vector2u(x,y))->getPayload();
+            change = 0;
+            for (unsigned int i = generations; i != generations-window; --i)
+            {
+                if (cycle[(cyclePhase+i)%period][offset] != cycle[(cyclePhase+i-1)%period][offset])
+                {
+                    change = i;
+                    break;
+                }
+            }
+            if (change == 0)
+            {
+                cell->setLife(cell->getLife()+generations);
+            }
+            else
+            {
+                cell->setLife(generations-change);
+                setState(cell,sf3d::Vector2u(x,y),cycle[(cyclePhase+generations)%period][offset]);
+            }
+        }
+    }
+    cyclePhase = (cyclePhase+generations)%period;
+    if (generationLoop != 0)
+    {
+        generationCount = (generationCount+(generations%generationLoop))%generationLoop;
+    }
+    else
+    {
+        generationCount += generations;
+    }
+    generationNumber += generations;
+    if (publication)
+    {
+        publish();
+    }
+}
+
+std::uint64_t NFE::CellularAutomaton::getRulesVersion() const
+{
+    return rules->getVersion<StateLife,STATE_LIFE_RULE>()+rules->getVersion<Transition,TRANSITION_RULE>()+rules->getVersion<Neighborhoods,NEIGHBORHOODS_RULE>()+rules->getVersion<NeighborhoodRadius,NEIGHBORHOOD_RADIUS_RULE>();
+}
+
+std::vector<unsigned int> NFE::CellularAutomaton::getStates() const
+{
+    std::vector<unsigned int> states;
+    states.reserve(cells->getSize().x*cells->getSize().y);
     for (unsigned int x = 0; x != cells->getSize().x; ++x)
     {
         for (unsigned int y = 0; y != cells->getSize().y; ++y)
         {
-            index.x = x;
-            index.y = y;
-            cell = this->cells->getUnit(index)->getPayload();
-            state = cells->getUnit(index)->getPayload()->getState();
-            update(cell,state);
+            states.push_back(cells->getUnit(sf3d::Vector2u(x,y))->getPayload()->getState());
         }
     }
+    return states;
 }
 
-void NFE::CellularAutomaton::update(Cell* cell,  unsigned int state)
+void NFE::CellularAutomaton::resetStateHash()
 {
-    if ((*rules->get<StateLife,STATE_LIFE_RULE>())(*cell,state))
+    stateHash = 0;
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
     {
-        cell->setLife(cell->getLife()+1);
+        for (unsigned int y = 0; y != cells->getSize().y; ++y)
+        {
+            stateHash ^= getStateKey(sf3d::Vector2u(x,y),cells->getUnit(sf3d::Vector2u(x,y))->getPayload()->getState());
+        }
     }
-    else
+}
+
+std::uint64_t NFE::CellularAutomaton::getStateKey(const sf3d::Vector2u& index, unsigned int state) const
+{
+    // a Zobrist key drawn from a counter based generator instead of a table, so any state count is supported
+    return util::hashMix64((((static_cast<std::uint64_t>(index.x)*cells->getSize().y)+index.y)<<32)^state^0x9e3779b97f4a7c15ULL);
+}
+
+std::uint64_t NFE::CellularAutomaton::getLifeKey(const sf3d::Vector2u& index, unsigned int life) const
+{
+    return util::hashMix64((((static_cast<std::uint64_t>(index.x)*cells->getSize().y)+index.y)<<32)^life^0xd1b54a32d192ed03ULL);
+}
+
+void NFE::CellularAutomaton::publish()
+{
+    // a fresh copy is swapped in every step, so a reader polling at any rate gets the latest generation.
+    // The one it replaces goes back to the pool once the last reader lets go of it, and is filled again
+    // here instead of reallocated. Neither side takes a lock, the slots of the pool are exchanged atomically
+    Generation* generation = nullptr;
+    for (unsigned int i = 0; (i != GenerationPool::SIZE) && (generation == nullptr); ++i)
     {
-        //if (*rules->get<bool,LIFE_RESET_RULE>())
+        generation = generationPool->generations[i].exchange(nullptr);
+    }
+    if (generation == nullptr)
+    {
+        generation = new Generation();
+    }
+    generation->number = generationNumber;
+    generation->stateHash = stateHash;
+    if (generation->board.getSize() != cells->getSize())
+    {
+        generation->board = ArrayBoard(cells->getSize());
+    }
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != cells->getSize().y; ++y)
         {
-            cell->setLife(0);
+            generation->board.getCell(x,y) = *cells->getUnit(sf3d::Vector2u(x,y))->getPayload();
         }
-        cell->setState(state);
+    }
+    std::shared_ptr<GenerationPool> pool = generationPool;
+    publications.set<const Generation,PUBLISHED_GENERATION>(std::shared_ptr<const Generation>(generation,[pool](Generation* generation){
+        Generation* empty;
+        for (unsigned int i = 0; i != GenerationPool::SIZE; ++i)
+        {
+            empty = nullptr;
+            if (pool->generations[i].compare_exchange_strong(empty,generation))
+            {
+                return;
+            }
+        }
+        // more copies are held than the pool keeps
+        delete generation;
+    }));
+}
+
+NFE::CellularAutomaton::GenerationPool::GenerationPool()
+{
+    for (unsigned int i = 0; i != SIZE; ++i)
+    {
+        generations[i].store(nullptr);
+    }
+}
+
+NFE::CellularAutomaton::GenerationPool::~GenerationPool()
+{
+    for (unsigned int i = 0; i != SIZE; ++i)
+    {
+        delete generations[i].load();
     }
 }
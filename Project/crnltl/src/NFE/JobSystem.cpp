@@ -0,0 +1,81 @@
+#include <NFE/JobSystem.hpp>
+
+NFE::JobSystem::JobSystem(unsigned int workers) :
+    stopping(false)
+{
+    if (workers == 0)
+    {
+        // one core is left to the thread that submits, which is usually the render thread
+        workers = std::thread::hardware_concurrency();
+        workers = (workers > 1)?workers-1:1;
+    }
+    for (unsigned int i = 0; i != workers; ++i)
+    {
+        this->workers.push_back(std::thread(&JobSystem::work,this));
+    }
+}
+
+NFE::JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (unsigned int i = 0; i != workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+}
+
+void NFE::JobSystem::execute(const std::function<void()>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    condition.notify_one();
+}
+
+NFE::RepositoryExecutor NFE::JobSystem::getExecutor()
+{
+    return [this](std::function<void()> job){execute(job);};
+}
+
+unsigned int NFE::JobSystem::getWorkerCount() const
+{
+    return static_cast<unsigned int>(workers.size());
+}
+
+unsigned int NFE::JobSystem::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<unsigned int>(jobs.size());
+}
+
+NFE::JobSystem* NFE::JobSystem::getInstance()
+{
+    static JobSystem instance;
+    return &instance;
+}
+
+void NFE::JobSystem::work()
+{
+    std::function<void()> job;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock,[this](){return ((stopping) || (!jobs.empty()));});
+            // the queue is drained before stopping, so that no future is left without a value
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+        job = nullptr;
+    }
+}
@@ -0,0 +1,298 @@
+#include <NFE/MappedFile.hpp>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+NFE::MappedFile::MappedFile() :
+    data(nullptr),
+    size(0),
+    writable(false),
+#ifdef _WIN32
+    file(INVALID_HANDLE_VALUE),
+    mapping(nullptr)
+#else
+    descriptor(-1)
+#endif
+{
+
+}
+
+NFE::MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool NFE::MappedFile::create(const std::string& path, std::uint64_t size)
+{
+    return map(path,size,true,true);
+}
+
+bool NFE::MappedFile::open(const std::string& path, bool writable)
+{
+    return map(path,0,writable,false);
+}
+
+bool NFE::MappedFile::map(const std::string& path, std::uint64_t size, bool writable, bool truncate)
+{
+    close();
+    this->writable = writable;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(),GENERIC_READ|(writable?GENERIC_WRITE:0),FILE_SHARE_READ,nullptr,truncate?CREATE_ALWAYS:OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER length;
+    if (truncate)
+    {
+        length.QuadPart = static_cast<LONGLONG>(size);
+        if ((!SetFilePointerEx(file,length,nullptr,FILE_BEGIN)) || (!SetEndOfFile(file)))
+        {
+            close();
+            return false;
+        }
+    }
+    else
+    {
+        if (!GetFileSizeEx(file,&length))
+        {
+            close();
+            return false;
+        }
+        size = static_cast<std::uint64_t>(length.QuadPart);
+    }
+    this->size = size;
+    if (size == 0)
+    {
+        return true;
+    }
+    mapping = CreateFileMappingA(file,nullptr,writable?PAGE_READWRITE:PAGE_READONLY,static_cast<DWORD>(size>>32),static_cast<DWORD>(size&0xFFFFFFFF),nullptr);
+    if (mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+    data = static_cast<unsigned char*>(MapViewOfFile(mapping,writable?FILE_MAP_WRITE:FILE_MAP_READ,0,0,0));
+#else
+    int flags = writable?O_RDWR:O_RDONLY;
+    if (truncate)
+    {
+        flags |= O_CREAT|O_TRUNC;
+    }
+    descriptor = ::open(path.c_str(),flags,0644);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+    if (truncate)
+    {
+        if (ftruncate(descriptor,static_cast<off_t>(size)) != 0)
+        {
+            close();
+            return false;
+        }
+    }
+    else
+    {
+        struct stat status;
+        if (fstat(descriptor,&status) != 0)
+        {
+            close();
+            return false;
+        }
+        size = static_cast<std::uint64_t>(status.st_size);
+    }
+    this->size = size;
+    if (size == 0)
+    {
+        return true;
+    }
+    void* address = mmap(nullptr,static_cast<size_t>(size),PROT_READ|(writable?PROT_WRITE:0),MAP_SHARED,descriptor,0);
+    data = (address == MAP_FAILED)?nullptr:static_cast<unsigned char*>(address);
+#endif
+    if (data == nullptr)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void NFE::MappedFile::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data != nullptr)
+    {
+        munmap(data,static_cast<size_t>(size));
+    }
+    if (descriptor >= 0)
+    {
+        ::close(descriptor);
+        descriptor = -1;
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    writable = false;
+}
+
+bool NFE::MappedFile::resize(std::uint64_t size)
+{
+    if ((!isOpen()) || (!writable) || (size == 0))
+    {
+        return false;
+    }
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+        data = nullptr;
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    LARGE_INTEGER length;
+    length.QuadPart = static_cast<LONGLONG>(size);
+    if ((!SetFilePointerEx(file,length,nullptr,FILE_BEGIN)) || (!SetEndOfFile(file)))
+    {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file,nullptr,PAGE_READWRITE,static_cast<DWORD>(size>>32),static_cast<DWORD>(size&0xFFFFFFFF),nullptr);
+    if (mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+    data = static_cast<unsigned char*>(MapViewOfFile(mapping,FILE_MAP_WRITE,0,0,0));
+#else
+    if (data != nullptr)
+    {
+        munmap(data,static_cast<size_t>(this->size));
+        data = nullptr;
+    }
+    if (ftruncate(descriptor,static_cast<off_t>(size)) != 0)
+    {
+        close();
+        return false;
+    }
+    void* address = mmap(nullptr,static_cast<size_t>(size),PROT_READ|PROT_WRITE,MAP_SHARED,descriptor,0);
+    data = (address == MAP_FAILED)?nullptr:static_cast<unsigned char*>(address);
+#endif
+    this->size = size;
+    if (data == nullptr)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool NFE::MappedFile::flush(std::uint64_t offset, std::uint64_t length)
+{
+    if ((data == nullptr) || (!writable) || (offset >= size))
+    {
+        return false;
+    }
+    if ((length == 0) || (offset+length > size))
+    {
+        length = size-offset;
+    }
+#ifdef _WIN32
+    if (!FlushViewOfFile(data+offset,static_cast<SIZE_T>(length)))
+    {
+        return false;
+    }
+    return (FlushFileBuffers(file) != 0);
+#else
+    // msync wants a page aligned address
+    std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    std::uint64_t start = offset-(offset%page);
+    return (msync(data+start,static_cast<size_t>(length+(offset-start)),MS_SYNC) == 0);
+#endif
+}
+
+void NFE::MappedFile::advise(std::uint64_t offset, std::uint64_t length, Advice advice) const
+{
+    if ((data == nullptr) || (offset >= size))
+    {
+        return;
+    }
+    if ((length == 0) || (offset+length > size))
+    {
+        length = size-offset;
+    }
+#ifdef _WIN32
+    // the hints are only forwarded on POSIX systems, Windows pages the view in on demand
+    (void)advice;
+#else
+    int hint;
+    switch (advice)
+    {
+    case SEQUENTIAL:
+        hint = POSIX_MADV_SEQUENTIAL;
+        break;
+    case RANDOM:
+        hint = POSIX_MADV_RANDOM;
+        break;
+    case WILL_NEED:
+        hint = POSIX_MADV_WILLNEED;
+        break;
+    case DONT_NEED:
+        hint = POSIX_MADV_DONTNEED;
+        break;
+    default:
+        hint = POSIX_MADV_NORMAL;
+        break;
+    }
+    std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    std::uint64_t start = offset-(offset%page);
+    posix_madvise(data+start,static_cast<size_t>(length+(offset-start)),hint);
+#endif
+}
+
+bool NFE::MappedFile::isOpen() const
+{
+#ifdef _WIN32
+    return (file != INVALID_HANDLE_VALUE);
+#else
+    return (descriptor >= 0);
+#endif
+}
+
+bool NFE::MappedFile::isWritable() const
+{
+    return writable;
+}
+
+std::uint64_t NFE::MappedFile::getSize() const
+{
+    return size;
+}
+
+unsigned char* NFE::MappedFile::getData() const
+{
+    return data;
+}
@@ -279,6 +279,27 @@ unsigned int NFE::util::hashInts(const std::vector<unsigned int>& ints, unsigned
     return c;
 }
 
+std::uint64_t NFE::util::hashMix64(std::uint64_t x)
+{
+    // the splitmix64 finalizer
+    x ^= x>>30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x>>27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x>>31;
+    return x;
+}
+
+std::uint64_t NFE::util::hashInts64(const std::vector<unsigned int>& ints, std::uint64_t seed)
+{
+    std::uint64_t hash = hashMix64(seed+ints.size());
+    for (unsigned int i = 0; i != ints.size(); ++i)
+    {
+        hash = (hash^ints[i])*0x100000001b3ULL;
+    }
+    return hashMix64(hash);
+}
+
 float NFE::util::clamp(float front, float back, float value)
 {
     return std::min(std::max(value,front),back);
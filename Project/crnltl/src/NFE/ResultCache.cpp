@@ -0,0 +1,267 @@
+#include <NFE/ResultCache.hpp>
+#include <NFE/CellFile.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+bool NFE::ResultCache::Key::operator<(const Key& other) const
+{
+    return (std::tie(factory,size.x,size.y,seed,generations,rules) < std::tie(other.factory,other.size.x,other.size.y,other.seed,other.generations,other.rules));
+}
+
+NFE::ResultCache::Result::Result(const ArrayBoard& board) :
+    board(board)
+{
+    const sf3d::Vector2u& size = board.getSize();
+    image.create(size.x,size.y);
+    lifeImage.create(size.x,size.y);
+    for (unsigned int x = 0; x != size.x; ++x)
+    {
+        for (unsigned int y = 0; y != size.y; ++y)
+        {
+            image.setPixel(x,y,CellularAutomaton::getCellColor(board.getCell(x,y),false));
+            lifeImage.setPixel(x,y,CellularAutomaton::getCellColor(board.getCell(x,y),true));
+        }
+    }
+}
+
+const NFE::ArrayBoard& NFE::ResultCache::Result::getBoard() const
+{
+    return board;
+}
+
+const sf3d::Image& NFE::ResultCache::Result::getImage(bool life) const
+{
+    if (life)
+    {
+        return lifeImage;
+    }
+    return image;
+}
+
+NFE::ResultCache::ResultCache(unsigned int capacity) :
+    capacity(capacity)
+{
+
+}
+
+NFE::ResultCache::~ResultCache()
+{
+
+}
+
+std::shared_ptr<const NFE::ResultCache::Result> NFE::ResultCache::get(const Key& key)
+{
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<Key,Entries::iterator>::iterator iter = index.find(key);
+        if (iter != index.end())
+        {
+            entries.splice(entries.begin(),entries,iter->second);
+            return iter->second->second;
+        }
+        directory = this->directory;
+    }
+    if (directory.empty())
+    {
+        return nullptr;
+    }
+    std::shared_ptr<const Result> result = load(directory,key);
+    if (result != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        insert(key,result);
+    }
+    return result;
+}
+
+std::shared_ptr<const NFE::ResultCache::Result> NFE::ResultCache::put(const Key& key, const CellularAutomaton* automaton)
+{
+    const CellularAutomaton::Cells* cells = automaton->getCells();
+    ArrayBoard board(cells->getSize());
+    for (unsigned int x = 0; x != cells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != cells->getSize().y; ++y)
+        {
+            board.getCell(x,y) = *cells->getUnit(sf3d::Vector2u(x,y))->getPayload();
+        }
+    }
+    std::shared_ptr<const Result> result = std::make_shared<const Result>(board);
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        insert(key,result);
+        directory = this->directory;
+    }
+    if (!directory.empty())
+    {
+        store(directory,key,*result);
+    }
+    return result;
+}
+
+std::shared_ptr<const NFE::ResultCache::Result> NFE::ResultCache::run(const std::string& factoryName, Factory factory, const sf3d::Vector2u& size, unsigned int seed, unsigned int generations, std::uint64_t rules)
+{
+    Key key;
+    key.factory = factoryName;
+    key.size = size;
+    key.seed = seed;
+    key.generations = generations;
+    key.rules = rules;
+    std::shared_ptr<const Result> result = get(key);
+    if (result != nullptr)
+    {
+        return result;
+    }
+    // two threads missing on the same key both compute it, the boards are identical so the last one simply wins
+    Random random(seed);
+    CellularAutomaton* automaton = factory(size,&random);
+    automaton->advance(generations);
+    result = put(key,automaton);
+    delete automaton;
+    return result;
+}
+
+void NFE::ResultCache::setDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->directory = directory;
+}
+
+std::string NFE::ResultCache::getDirectory() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return directory;
+}
+
+void NFE::ResultCache::setCapacity(unsigned int capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->capacity = capacity;
+    trim();
+}
+
+unsigned int NFE::ResultCache::getCapacity() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return capacity;
+}
+
+unsigned int NFE::ResultCache::getCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<unsigned int>(entries.size());
+}
+
+void NFE::ResultCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    index.clear();
+    entries.clear();
+}
+
+NFE::ResultCache* NFE::ResultCache::getInstance()
+{
+    static ResultCache instance;
+    return &instance;
+}
+
+void NFE::ResultCache::insert(const Key& key, std::shared_ptr<const Result> result)
+{
+    std::map<Key,Entries::iterator>::iterator iter = index.find(key);
+    if (iter != index.end())
+    {
+        iter->second->second = result;
+        entries.splice(entries.begin(),entries,iter->second);
+        return;
+    }
+    entries.push_front(Entry(key,result));
+    index[key] = entries.begin();
+    trim();
+}
+
+void NFE::ResultCache::trim()
+{
+    while (entries.size() > capacity)
+    {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+std::shared_ptr<const NFE::ResultCache::Result> NFE::ResultCache::load(const std::string& directory, const Key& key) const
+{
+    CellFile file;
+    if (!file.open(getPath(directory,key)))
+    {
+        return nullptr;
+    }
+    if ((file.getSize().x != key.size.x) || (file.getSize().y != key.size.y))
+    {
+        return nullptr;
+    }
+    ArrayBoard board(key.size);
+    const std::uint32_t* records;
+    for (unsigned int y = 0; y != key.size.y; ++y)
+    {
+        records = file.getRow(y);
+        for (unsigned int x = 0; x != key.size.x; ++x)
+        {
+            board.getCell(x,y) = Cell(records[x*2],records[(x*2)+1]);
+        }
+    }
+    return std::make_shared<const Result>(board);
+}
+
+bool NFE::ResultCache::store(const std::string& directory, const Key& key, const Result& result) const
+{
+    // written aside and renamed into place, so that a reader never maps a half written file
+    // the name is unique per writer, since two threads or processes that miss the same key store it at once
+    static std::atomic<unsigned int> writers(0);
+    std::string path = getPath(directory,key);
+    std::ostringstream name;
+    name << path << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << "_" << std::chrono::steady_clock::now().time_since_epoch().count() << "_" << writers.fetch_add(1) << ".tmp";
+    std::string temporary = name.str();
+    CellFile file;
+    if (!file.create(temporary,key.size))
+    {
+        return false;
+    }
+    std::uint32_t* records;
+    for (unsigned int y = 0; y != key.size.y; ++y)
+    {
+        records = file.getRow(y);
+        for (unsigned int x = 0; x != key.size.x; ++x)
+        {
+            records[x*2] = result.getBoard().getCell(x,y).getState();
+            records[(x*2)+1] = result.getBoard().getCell(x,y).getLife();
+        }
+    }
+    bool success = ((key.size.x == 0) || (key.size.y == 0) || file.flush());
+    file.close();
+#ifdef _WIN32
+    // Windows will not rename over an existing file, and the one there holds the same result
+    if (success)
+    {
+        std::remove(path.c_str());
+    }
+#endif
+    if ((!success) || (std::rename(temporary.c_str(),path.c_str()) != 0))
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string NFE::ResultCache::getPath(const std::string& directory, const Key& key)
+{
+    std::ostringstream path;
+    path << directory << "/" << key.factory << "_" << key.size.x << "x" << key.size.y << "_" << key.seed << "_" << key.generations << "_" << std::hex << key.rules << ".cells";
+    return path.str();
+}
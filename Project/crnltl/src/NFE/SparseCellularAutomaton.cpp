@@ -0,0 +1,313 @@
+#include <NFE/SparseCellularAutomaton.hpp>
+#include <algorithm>
+
+NFE::SparseCellularAutomaton::SparseCellularAutomaton() :
+    generationCount(0),
+    rules(nullptr),
+    cells(nullptr),
+    generation(nullptr)
+{
+    CellularAutomaton prototype;
+    adopt(prototype);
+}
+
+NFE::SparseCellularAutomaton::SparseCellularAutomaton(const CellularAutomaton& prototype) :
+    generationCount(0),
+    rules(nullptr),
+    cells(nullptr),
+    generation(nullptr)
+{
+    adopt(prototype);
+}
+
+NFE::SparseCellularAutomaton::~SparseCellularAutomaton()
+{
+    delete rules;
+    delete cells;
+    delete generation;
+    for (unsigned int i = 0; i != spare.size(); ++i)
+    {
+        delete spare[i];
+    }
+}
+
+void NFE::SparseCellularAutomaton::adopt(const CellularAutomaton& prototype)
+{
+    Rules* other = prototype.getRules();
+    const CellularAutomaton::Cells* otherCells = prototype.getCells();
+    Cell* cell;
+    sf3d::Vector2u index;
+    rules = new Rules();
+    rules->set<CellularAutomaton::StateLife,CellularAutomaton::STATE_LIFE_RULE>(other->get<CellularAutomaton::StateLife,CellularAutomaton::STATE_LIFE_RULE>());
+    rules->set<CellularAutomaton::Transition,CellularAutomaton::TRANSITION_RULE>(other->get<CellularAutomaton::Transition,CellularAutomaton::TRANSITION_RULE>());
+    rules->set<CellularAutomaton::Neighborhoods,CellularAutomaton::NEIGHBORHOODS_RULE>(other->get<CellularAutomaton::Neighborhoods,CellularAutomaton::NEIGHBORHOODS_RULE>());
+    rules->set<CellularAutomaton::NeighborhoodRadius,CellularAutomaton::NEIGHBORHOOD_RADIUS_RULE>(other->get<CellularAutomaton::NeighborhoodRadius,CellularAutomaton::NEIGHBORHOOD_RADIUS_RULE>());
+    rules->set<CellularAutomaton::CascadeStateMap,CellularAutomaton::INBOUND_CASCADE_STATE_MAP_RULE>(other->get<CellularAutomaton::CascadeStateMap,CellularAutomaton::INBOUND_CASCADE_STATE_MAP_RULE>());
+    rules->set<CellularAutomaton::CascadeStateMap,CellularAutomaton::OUTBOUND_CASCADE_STATE_MAP_RULE>(other->get<CellularAutomaton::CascadeStateMap,CellularAutomaton::OUTBOUND_CASCADE_STATE_MAP_RULE>());
+    cells = new Cells(Cell(0));
+    generation = new Cells(Cell(0));
+    for (unsigned int x = 0; x != otherCells->getSize().x; ++x)
+    {
+        for (unsigned int y = 0; y != otherCells->getSize().y; ++y)
+        {
+            index.x = x;
+            index.y = y;
+            cell = otherCells->getUnit(index)->getPayload();
+            if (cell->getState() != 0)
+            {
+                cells->setUnit(*cell,sf3d::Vector2i(index));
+            }
+        }
+    }
+}
+
+int NFE::SparseCellularAutomaton::getReach(const CellularAutomaton::NeighborhoodRadius& radius)
+{
+    int reach = 0;
+    for (CellularAutomaton::NeighborhoodRadius::const_iterator iter1 = radius.begin(); iter1 != radius.end(); ++iter1)
+    {
+        for (CellularAutomaton::StateRadius::const_iterator iter2 = iter1->second.begin(); iter2 != iter1->second.end(); ++iter2)
+        {
+            reach = std::max(reach,static_cast<int>(std::round(fabsf(iter2->second.x))));
+            reach = std::max(reach,static_cast<int>(std::round(fabsf(iter2->second.y))));
+        }
+    }
+    return (reach+Cells::CHUNK_SIZE-1)/Cells::CHUNK_SIZE;
+}
+
+void NFE::SparseCellularAutomaton::goToNextGeneration()
+{
+    Neighbors neighbors = Neighbors();
+    std::shared_ptr<CellularAutomaton::Transition> transition = rules->get<CellularAutomaton::Transition,CellularAutomaton::TRANSITION_RULE>();
+    std::shared_ptr<CellularAutomaton::StateLife> stateLife = rules->get<CellularAutomaton::StateLife,CellularAutomaton::STATE_LIFE_RULE>();
+    // The rules are loaded once per generation rather than once per cell.
+    std::shared_ptr<CellularAutomaton::NeighborhoodRadius> radius = rules->get<CellularAutomaton::NeighborhoodRadius,CellularAutomaton::NEIGHBORHOOD_RADIUS_RULE>();
+    std::shared_ptr<CellularAutomaton::Neighborhoods> neighborhoods = rules->get<CellularAutomaton::Neighborhoods,CellularAutomaton::NEIGHBORHOODS_RULE>();
+    std::vector<Cells::ChunkIndex> active;
+    int reach = getReach(*radius);
+    int span = (reach*2)+1;
+    active.reserve(cells->getChunkCount()*span*span);
+    for (Cells::Chunks::const_iterator iter = cells->getChunks().begin(); iter != cells->getChunks().end(); ++iter)
+    {
+        for (int x = -reach; x != reach+1; ++x)
+        {
+            for (int y = -reach; y != reach+1; ++y)
+            {
+                active.push_back(Cells::ChunkIndex(iter->first.first+x,iter->first.second+y));
+            }
+        }
+    }
+    std::sort(active.begin(),active.end());
+    active.erase(std::unique(active.begin(),active.end()),active.end());
+    Window window(span*span,nullptr);
+    Cells::Chunk* chunk;
+    unsigned int state;
+    bool live;
+    for (std::vector<Cells::ChunkIndex>::const_iterator iter = active.begin(); iter != active.end(); ++iter)
+    {
+        for (int x = -reach; x != reach+1; ++x)
+        {
+            for (int y = -reach; y != reach+1; ++y)
+            {
+                window[((x+reach)*span)+(y+reach)] = static_cast<const Cells*>(cells)->getChunk(Cells::ChunkIndex(iter->first+x,iter->second+y));
+            }
+        }
+        const Cells::Chunk* center = window[(reach*span)+reach];
+        // Every unit is written below, so a chunk released by an earlier generation can be reused as is.
+        if (spare.empty())
+        {
+            chunk = new Cells::Chunk(*iter,cells->getFill());
+        }
+        else
+        {
+            chunk = spare.back();
+            spare.pop_back();
+            chunk->setIndex(*iter);
+        }
+        live = false;
+        for (int x = 0; x != Cells::CHUNK_SIZE; ++x)
+        {
+            for (int y = 0; y != Cells::CHUNK_SIZE; ++y)
+            {
+                const Cell& cell = (center != nullptr)?center->getUnit(x,y):cells->getFill();
+                Cell& next = chunk->getUnit(x,y);
+                getNeighbors(cell,x,y,window,reach,*radius,*neighborhoods,neighbors);
+                state = (*transition)(cell,neighbors);
+                neighbors.clear();
+                next = cell;
+                if ((*stateLife)(cell,state))
+                {
+                    next.setLife(cell.getLife()+1);
+                }
+                else
+                {
+                    next.setLife(0);
+                    next.setState(state);
+                }
+                if (next.getState() != 0)
+                {
+                    live = true;
+                }
+            }
+        }
+        if (live)
+        {
+            generation->insertChunk(chunk);
+        }
+        else
+        {
+            spare.push_back(chunk);
+        }
+    }
+    std::swap(cells,generation);
+    generation->recycle(spare);
+    ++generationCount;
+}
+
+void NFE::SparseCellularAutomaton::getNeighbors(const Cell& cell, int x, int y, const Window& window, int reach, const CellularAutomaton::NeighborhoodRadius& radius, const CellularAutomaton::Neighborhoods& neighborhoods, Neighbors& neighbors)
+{
+    CellularAutomaton::Rule rule;
+    CellularAutomaton::Neighborhood* neighborhood;
+    CellularAutomaton::NeighborhoodRadius::const_iterator iter1;
+    CellularAutomaton::StateRadius::const_iterator iter2;
+    CellularAutomaton::Rule::iterator iter3;
+    const Cells::Chunk* chunk;
+    sf3d::Vector2i position;
+    unsigned int stateOther;
+    unsigned int state = cell.getState();
+    int span = (reach*2)+1;
+    for (unsigned int i = 0; i != neighborhoods.size(); ++i)
+    {
+        iter1 = radius.find(i);
+        if (iter1 == radius.end())
+        {
+            continue;
+        }
+        iter2 = iter1->second.find(state);
+        if (iter2 == iter1->second.end())
+        {
+            continue;
+        }
+        neighborhood = neighborhoods[i];
+        if (neighborhood == nullptr)
+        {
+            continue;
+        }
+        const CellularAutomaton::Neighborhood::Contents& stencil = neighborhood->getStencil(iter2->second);
+        for (unsigned int j = 0; j != stencil.size(); ++j)
+        {
+            position.x = x+stencil[j].x;
+            position.y = y+stencil[j].y;
+            chunk = window[((Cells::getChunkCoordinate(position.x)+reach)*span)+(Cells::getChunkCoordinate(position.y)+reach)];
+            if (chunk != nullptr)
+            {
+                stateOther = chunk->getUnit(Cells::getLocal(position.x),Cells::getLocal(position.y)).getState();
+            }
+            else
+            {
+                stateOther = cells->getFill().getState();
+            }
+            iter3 = rule.find(stateOther);
+            if (iter3 == rule.end())
+            {
+                rule[stateOther] = 1;
+            }
+            else
+            {
+                ++iter3->second;
+            }
+        }
+        if (!rule.empty())
+        {
+            // Hands the counted nodes over instead of copying them into the neighbors.
+            neighbors[i].swap(rule);
+        }
+    }
+}
+
+void NFE::SparseCellularAutomaton::setState(const sf3d::Vector2i& position, unsigned int state)
+{
+    if ((state == 0) && (static_cast<const Cells*>(cells)->getChunk(Cells::getChunkIndex(position)) == nullptr))
+    {
+        return;
+    }
+    cells->setUnit(Cell(state),position);
+}
+
+unsigned int NFE::SparseCellularAutomaton::getState(const sf3d::Vector2i& position) const
+{
+    return cells->getUnit(position).getState();
+}
+
+unsigned int NFE::SparseCellularAutomaton::getGenerationCount() const
+{
+    return generationCount;
+}
+
+unsigned int NFE::SparseCellularAutomaton::getChunkCount() const
+{
+    return cells->getChunkCount();
+}
+
+unsigned int NFE::SparseCellularAutomaton::getCellsOfStateCount(unsigned int state) const
+{
+    unsigned int result = 0;
+    for (Cells::Chunks::const_iterator iter = cells->getChunks().begin(); iter != cells->getChunks().end(); ++iter)
+    {
+        for (int x = 0; x != Cells::CHUNK_SIZE; ++x)
+        {
+            for (int y = 0; y != Cells::CHUNK_SIZE; ++y)
+            {
+                if (iter->second->getUnit(x,y).getState() == state)
+                {
+                    ++result;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+const NFE::SparseCellularAutomaton::Cells* NFE::SparseCellularAutomaton::getCells() const
+{
+    return cells;
+}
+
+NFE::SparseCellularAutomaton::Rules* NFE::SparseCellularAutomaton::getRules() const
+{
+    return rules;
+}
+
+sf3d::Image* NFE::SparseCellularAutomaton::getImage(const sf3d::Vector2i& origin, const sf3d::Vector2u& size, bool life) const
+{
+    sf3d::Image* image = new sf3d::Image();
+    if ((size.x == 0) || (size.y == 0))
+    {
+        return image;
+    }
+    image->create(size.x,size.y);
+    for (unsigned int x = 0; x != size.x; ++x)
+    {
+        for (unsigned int y = 0; y != size.y; ++y)
+        {
+            const Cell& cell = cells->getUnit(origin+sf3d::Vector2i(sf3d::Vector2u(x,y)));
+            if (life)
+            {
+                image->setPixel(x,y,CellularAutomaton::mixColors(sf3d::Color::Black,CellularAutomaton::getColorFromKey(static_cast<int>(cell.getState()+1)),1.0f/static_cast<float>(cell.getLife()+1),true));
+            }
+            else
+            {
+                image->setPixel(x,y,CellularAutomaton::getColorFromKey(static_cast<int>(cell.getState()+1)));
+            }
+        }
+    }
+    return image;
+}
+
+NFE::SparseCellularAutomaton* NFE::SparseCellularAutomaton::getConwayGameOfLife(const sf3d::Vector2u& size, Random* random)
+{
+    CellularAutomaton* prototype = CellularAutomaton::getConwayGameOfLife(size,random);
+    SparseCellularAutomaton* life = new SparseCellularAutomaton(*prototype);
+    delete prototype;
+    return life;
+}
@@ -5,9 +5,9 @@ Agent::Agent(bool doesPoll, bool doesSubmit) :
 	mIsRunning(true),
 	mIsShutdown(false),
 	mDoesPoll(doesPoll),
-	mDoesSubmit(doesSubmit)
+	mDoesSubmit(doesSubmit),
+	mThread(nullptr)
 {
-	mThread = new std::thread(&Agent::run,this);
 }
 
 Agent::~Agent()
@@ -28,6 +28,13 @@ bool Agent::getIsShutdown()
 	return mIsShutdown;
 }
 
+void Agent::start()
+{
+	if (mThread != nullptr)
+		return;
+	mThread = new std::thread(&Agent::run,this);
+}
+
 void Agent::run()
 {
 	while (true)
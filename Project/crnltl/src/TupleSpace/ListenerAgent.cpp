@@ -3,10 +3,12 @@
 ListenerAgent::ListenerAgent() :
 	Agent(false,true),
 	mTupleToSubmit(nullptr),
-	mIsInitialized(false)
+	mIsInitialized(false),
+	mConnectionTag(TUPLE_SPACE->intern("NEW_CONNECTION"))
 {
 	mListener = new sf3d::TcpListener();
 	mListener->setBlocking(false);
+	start();
 }
 
 ListenerAgent::~ListenerAgent()
@@ -37,7 +39,7 @@ void ListenerAgent::submit()
 {
 	if (mTupleToSubmit == nullptr)
 		return;
-	TUPLE_SPACE->put("NEW_CONNECTION", mTupleToSubmit);
+	TUPLE_SPACE->put(mConnectionTag, mTupleToSubmit);
 	mTupleToSubmit = nullptr;
 }
 
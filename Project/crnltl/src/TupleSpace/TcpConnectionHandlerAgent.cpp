@@ -6,12 +6,12 @@ TcpConnectionHandlerAgent::TcpConnectionHandlerAgent(unsigned short listenPort,
 	Agent(true, false),
 	mHasNewConnection(false),
 	mNewConnectionData(nullptr),
-	mBlockingListener(CreateSemaphore(nullptr, 0, maxConnections, "Client_Connection_Blocker")),
 	mSendAgent(new TcpSendAgent(0, nullptr)),
-	mReceiveAgent(new TcpReceiveAgent(0, nullptr))
+	mReceiveAgent(new TcpReceiveAgent(0, nullptr)),
+	mConnectionTag(TUPLE_SPACE->intern("NEW_CLIENT_CONNECTION"))
 {
-	TUPLE_SPACE->registerBlockingListener(std::string("NEW_CLIENT_CONNECTION"), mBlockingListener);
 	mListenAgent = new TcpListenerAgent(listenPort, maxConnections);
+	start();
 }
 
 
@@ -19,7 +19,8 @@ TcpConnectionHandlerAgent::TcpConnectionHandlerAgent(unsigned short listenPort,
 TcpConnectionHandlerAgent::TcpConnectionHandlerAgent(sf3d::IpAddress address, unsigned short remotePort) :
 	Agent(false, false),
 	mHasNewConnection(false),
-	mNewConnectionData(nullptr), mBlockingListener(nullptr), mListenAgent(nullptr)
+	mNewConnectionData(nullptr), mListenAgent(nullptr),
+	mConnectionTag(TUPLE_SPACE->intern("NEW_CLIENT_CONNECTION"))
 {
 	sf3d::TcpSocket* socket = new sf3d::TcpSocket();
 	sf3d::TcpSocket::Status status;
@@ -31,12 +32,14 @@ TcpConnectionHandlerAgent::TcpConnectionHandlerAgent(sf3d::IpAddress address, un
 	mConnections.push_back(socket);
 	mSendAgent = new TcpSendAgent(mConnections.size(), mConnections.data());
 	mReceiveAgent = new TcpReceiveAgent(mConnections.size(), mConnections.data());
+	start();
 }
 
 
 
 TcpConnectionHandlerAgent::~TcpConnectionHandlerAgent()
 {
+	destroy();
 	delete mSendAgent;
 	delete mReceiveAgent;
 	delete mListenAgent;
@@ -52,9 +55,7 @@ TcpConnectionHandlerAgent::~TcpConnectionHandlerAgent()
 
 void TcpConnectionHandlerAgent::poll()
 {
-	WaitForSingleObject(mBlockingListener, INFINITE);
-
-	mNewConnectionData = TUPLE_SPACE->get("NEW_CLIENT_CONNECTION");
+	mNewConnectionData = TUPLE_SPACE->get(mConnectionTag, std::chrono::milliseconds(AGENT_WAIT_TIME));
 	if (mNewConnectionData != nullptr)
 		mHasNewConnection = true;
 }
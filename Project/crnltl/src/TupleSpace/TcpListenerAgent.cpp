@@ -7,14 +7,17 @@ TcpListenerAgent::TcpListenerAgent(unsigned short port, unsigned char maxConnect
 	Agent(false, true),
 	mConnectionCount(0), isConnectionMade(false),
 	mPort(port),
-	mMaxConnectionCount(maxConnections)
+	mMaxConnectionCount(maxConnections),
+	mConnectionTag(TUPLE_SPACE->intern("NEW_CLIENT_CONNECTION"))
 {
+	start();
 }
 
 
 
 TcpListenerAgent::~TcpListenerAgent()
 {
+	destroy();
 	if (mNewSocket != nullptr)
 		delete mNewSocket;
 }
@@ -58,7 +61,7 @@ void TcpListenerAgent::submit()
 	if (!isConnectionMade)
 		return;
 
-	TUPLE_SPACE->put("NEW_CLIENT_CONNECTION", new Tuple("v", mNewSocket));
+	TUPLE_SPACE->put(mConnectionTag, new Tuple("v", mNewSocket));
 	mNewSocket = nullptr;
 	isConnectionMade = false;
 }
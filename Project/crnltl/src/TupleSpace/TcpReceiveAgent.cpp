@@ -5,14 +5,17 @@ TcpReceiveAgent::TcpReceiveAgent(unsigned char socketCount, sf3d::TcpSocket** so
 	Agent(false, true),
 	isReadyToPush(false),
 	mSenderCount(socketCount),
-	mSockets(sockets)
+	mSockets(sockets),
+	mReceiveTag(TUPLE_SPACE->intern("RECEIVE_PACKET"))
 {
+	start();
 }
 
 
 
 TcpReceiveAgent::~TcpReceiveAgent()
 {
+	destroy();
 	for (unsigned char i = 0; i < mSenderCount; ++i)
     {
         delete mSockets[i];
@@ -55,15 +58,23 @@ void TcpReceiveAgent::submit()
 	if (!isReadyToPush)
 		return;
 
+  std::vector<Tuple*> tuples;
   for (int i = 0; i < mPackets.size(); ++i)
   {
     sf3d::Packet* pack = new sf3d::Packet();
     pack->append(mPackets[i].getData(),mPackets[i].getDataSize());
     //memcpy_s(pack, sizeof(sf3d::Packet), &mPacket, sizeof(sf3d::Packet));
-    TUPLE_SPACE->put("RECEIVE_PACKET", new Tuple("v", pack));
+    tuples.push_back(new Tuple("v", pack));
     isReadyToPush = false;
   }
 
+  // only an interrupted put leaves packets behind, and nothing is put once the agent is shutting down
+  std::size_t submitted = mIsRunning ? TUPLE_SPACE->putMany(mReceiveTag, tuples) : 0;
+  for (std::size_t i = submitted; i < tuples.size(); ++i)
+  {
+    delete static_cast<sf3d::Packet*>(tuples[i]->getItemAsVoid(0));
+    delete tuples[i];
+  }
   mPackets.clear();
 }
 
@@ -74,3 +85,10 @@ void TcpReceiveAgent::setConnections(unsigned char connectionCount, sf3d::TcpSoc
 	mSockets = sockets;
 	mSenderCount = connectionCount;
 }
+
+
+
+void TcpReceiveAgent::onShutdown()
+{
+	TUPLE_SPACE->interrupt(mReceiveTag);
+}
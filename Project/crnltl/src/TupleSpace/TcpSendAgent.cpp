@@ -7,8 +7,9 @@ TcpSendAgent::TcpSendAgent(unsigned char socketCount, sf3d::TcpSocket** sockets)
 	mTuple(nullptr), mPacket(nullptr),
 	mRecipientCount(socketCount),
 	mSockets(sockets),
-	mBlockingListener(CreateSemaphore(nullptr, 0, 65535, "SSURGE_TcpSendAgent_Blocker"))
+	mReadyTag(TUPLE_SPACE->intern("PACKET_READY"))
 {
+	start();
 }
 
 
@@ -25,8 +26,7 @@ void TcpSendAgent::poll()
 {
 	deleteData();
 
-	//while(WaitForSingleObject(mBlockingListener, 5000) != WAIT_ABANDONED); // blocks until a packet is available
-	mTuple = TUPLE_SPACE->get("PACKET_READY");
+	mTuple = TUPLE_SPACE->get(mReadyTag, std::chrono::milliseconds(AGENT_WAIT_TIME)); // blocks until a packet is available
 
 	if (mTuple != nullptr)
 	{
@@ -1,207 +1,85 @@
 #include <TupleSpace/Tuple.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
 
-Tuple::Tuple(std::string code, ...) :
-	mCode(code)
+/// The length byte of a string item that holds a long string
+#define TUPLE_LONG_STRING 0xFF
+
+Tuple::Tuple(const char* code, ...) :
+	mSize(0),
+	mCapacity(TUPLE_INLINE_ITEMS),
+	mItems(mInlineItems),
+	mCode(mInlineCode)
 {
 	va_list list;
 	va_start(list, code);
-	for (int i = 0; i != mCode.size(); ++i)
-	{
-		BasicItem * item = nullptr;
-		switch (mCode[i])
-		{
-		case 'b':
-			item = new Item<bool>(va_arg(list, int)!=0);
-			break;
-		case 'i':
-			item = new Item<int>(va_arg(list, int));
-			break;
-		case 'f':
-			item = new Item<float>(static_cast<float>(va_arg(list, double)));
-			break;
-		case 'd':
-			item = new Item<double>(va_arg(list, double));
-			break;
-		case 'c':
-			item = new Item<char>(static_cast<char>(va_arg(list, int)));
-			break;
-		case 'l':
-			item = new Item<long>(va_arg(list, long));
-			break;
-		case 'u':
-			item = new Item<unsigned int>(static_cast<unsigned int>(va_arg(list, int)));
-			break;
-		case 's':
-			item = new Item<std::string>(std::string(va_arg(list, char*)));
-			break;
-		case 'v':
-			item = new Item<void*>(va_arg(list, void*));
-			break;
-		default:
-			if (i == mItems.size() - 1)
-			{
-				mCode = mCode.substr(0, i);
-				break;
-			}
-			mCode = mCode.substr(0, i) + mCode.substr(i + 1);
-			--i;
-			continue;
-		}
-		if (item != nullptr)
-		{
-			mItems.push_back(item);
-		}
-	}
+	append(code, &list);
 	va_end(list);
 }
 
-Tuple::Tuple(Tuple * tuple, std::string code, ...) :
-	mCode(code)
+Tuple::Tuple(Tuple * tuple, const char* code, ...) :
+	mSize(0),
+	mCapacity(TUPLE_INLINE_ITEMS),
+	mItems(mInlineItems),
+	mCode(mInlineCode)
 {
 	va_list list;
 	va_start(list, code);
-	for (int i = 0; i != mCode.size(); ++i)
-	{
-		BasicItem * item = nullptr;
-		switch (mCode[i])
-		{
-		case 'b':
-			item = new Item<bool>(va_arg(list, int)!=0);
-			break;
-		case 'i':
-			item = new Item<int>(va_arg(list, int));
-			break;
-		case 'f':
-			item = new Item<float>(static_cast<float>(va_arg(list, double)));
-			break;
-		case 'd':
-			item = new Item<double>(va_arg(list, double));
-			break;
-		case 'c':
-			item = new Item<char>(static_cast<char>(va_arg(list, int)));
-			break;
-		case 'l':
-			item = new Item<long>(va_arg(list, long));
-			break;
-		case 'u':
-			item = new Item<unsigned int>(static_cast<unsigned int>(va_arg(list, int)));
-			break;
-		case 's':
-			item = new Item<std::string>(std::string(va_arg(list, char*)));
-			break;
-		default:
-			if (i == mItems.size() - 1)
-			{
-				mCode = mCode.substr(0, i);
-				break;
-			}
-			mCode = mCode.substr(0, i) + mCode.substr(i + 1);
-			--i;
-			continue;
-		}
-		if (item != nullptr)
-		{
-			mItems.push_back(item);
-		}
-	}
+	append(code, &list);
+	va_end(list);
 	if (tuple)
 	{
-		code = tuple->getCode();
-		for (int i = 0; i != tuple->getSize(); ++i)
+		for (unsigned int i = 0; i != tuple->mSize; ++i)
 		{
-			BasicItem * item = nullptr;
-			switch (code[i])
-			{
-			case 'b':
-				item = new Item<bool>(tuple->getItemAsBool(i));
-				break;
-			case 'i':
-				item = new Item<int>(tuple->getItemAsInt(i));
-				break;
-			case 'f':
-				item = new Item<float>(tuple->getItemAsFloat(i));
-				break;
-			case 'd':
-				item = new Item<double>(tuple->getItemAsDouble(i));
-				break;
-			case 'c':
-				item = new Item<char>(tuple->getItemAsChar(i));
-				break;
-			case 'l':
-				item = new Item<long>(tuple->getItemAsLong(i));
-				break;
-			case 'u':
-				item = new Item<unsigned int>(tuple->getItemAsUnsignedInt(i));
-				break;
-			case 's':
-				item = new Item<std::string>(tuple->getItemAsString(i));
-				break;
-			default:
-				if (i == mItems.size() - 1)
-				{
-					code = code.substr(0, i);
-					break;
-				}
-				code = code.substr(0, i) + code.substr(i + 1);
-				--i;
-				continue;
-			}
-			if (item != nullptr)
-			{
-				mItems.push_back(item);
-				mCode.push_back(code[i]);
-			}
+			Item item;
+			copyItem(tuple->mCode[i], tuple->mItems[i], item);
+			addItem(tuple->mCode[i], item);
 		}
 	}
-	va_end(list);
 }
 
 Tuple::~Tuple()
 {
-	for (int i = 0; i != mItems.size(); ++i)
+	for (unsigned int i = 0; i != mSize; ++i)
 	{
-		delete mItems[i];
+		destroyItem(mCode[i], mItems[i]);
+	}
+	if (mItems != mInlineItems)
+	{
+		delete[] mItems;
+		delete[] mCode;
 	}
-	mItems.clear();
 }
 
 bool Tuple::getItemAsBool(unsigned int index)
 {
 	bool error = false;
-	char code = 'b';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<bool>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mBool);
 	case 'i':
-		return static_cast<bool>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mInt);
 	case 'f':
-		return static_cast<bool>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mFloat);
 	case 'd':
-		return static_cast<bool>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mDouble);
 	case 'c':
-		return static_cast<bool>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mChar);
 	case 'l':
-		return static_cast<bool>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mLong);
 	case 'u':
-		return static_cast<bool>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<bool>(item.mUnsignedInt);
 	case 's':
-		return static_cast<bool>(atoi(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<bool>(atoi(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -210,40 +88,30 @@ bool Tuple::getItemAsBool(unsigned int index)
 int Tuple::getItemAsInt(unsigned int index)
 {
 	int error = 0;
-	char code = 'i';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<int>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mBool);
 	case 'i':
-		return static_cast<int>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mInt);
 	case 'f':
-		return static_cast<int>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mFloat);
 	case 'd':
-		return static_cast<int>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mDouble);
 	case 'c':
-		return static_cast<int>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mChar);
 	case 'l':
-		return static_cast<int>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mLong);
 	case 'u':
-		return static_cast<int>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<int>(item.mUnsignedInt);
 	case 's':
-		return static_cast<int>(atoi(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<int>(atoi(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -252,40 +120,30 @@ int Tuple::getItemAsInt(unsigned int index)
 float Tuple::getItemAsFloat(unsigned int index)
 {
 	float error = 0.0f;
-	char code = 'f';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<float>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mBool);
 	case 'i':
-		return static_cast<float>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mInt);
 	case 'f':
-		return static_cast<float>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mFloat);
 	case 'd':
-		return static_cast<float>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mDouble);
 	case 'c':
-		return static_cast<float>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mChar);
 	case 'l':
-		return static_cast<float>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mLong);
 	case 'u':
-		return static_cast<float>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<float>(item.mUnsignedInt);
 	case 's':
-		return static_cast<float>(atof(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<float>(atof(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -294,40 +152,30 @@ float Tuple::getItemAsFloat(unsigned int index)
 double Tuple::getItemAsDouble(unsigned int index)
 {
 	double error = 0.0;
-	char code = 'd';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<double>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mBool);
 	case 'i':
-		return static_cast<double>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mInt);
 	case 'f':
-		return static_cast<double>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mFloat);
 	case 'd':
-		return static_cast<double>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mDouble);
 	case 'c':
-		return static_cast<double>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mChar);
 	case 'l':
-		return static_cast<double>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mLong);
 	case 'u':
-		return static_cast<double>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<double>(item.mUnsignedInt);
 	case 's':
-		return static_cast<double>(atof(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<double>(atof(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -336,40 +184,30 @@ double Tuple::getItemAsDouble(unsigned int index)
 char Tuple::getItemAsChar(unsigned int index)
 {
 	char error = 0;
-	char code = 'c';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<char>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mBool);
 	case 'i':
-		return static_cast<char>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mInt);
 	case 'f':
-		return static_cast<char>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mFloat);
 	case 'd':
-		return static_cast<char>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mDouble);
 	case 'c':
-		return static_cast<char>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mChar);
 	case 'l':
-		return static_cast<char>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mLong);
 	case 'u':
-		return static_cast<char>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<char>(item.mUnsignedInt);
 	case 's':
-		return static_cast<char>(atoi(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<char>(atoi(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -378,40 +216,30 @@ char Tuple::getItemAsChar(unsigned int index)
 long Tuple::getItemAsLong(unsigned int index)
 {
 	long error = 0;
-	char code = 'l';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<long>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mBool);
 	case 'i':
-		return static_cast<long>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mInt);
 	case 'f':
-		return static_cast<long>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mFloat);
 	case 'd':
-		return static_cast<long>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mDouble);
 	case 'c':
-		return static_cast<long>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mChar);
 	case 'l':
-		return static_cast<long>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mLong);
 	case 'u':
-		return static_cast<long>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<long>(item.mUnsignedInt);
 	case 's':
-		return static_cast<long>(atoi(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<long>(atoi(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -420,40 +248,30 @@ long Tuple::getItemAsLong(unsigned int index)
 unsigned int Tuple::getItemAsUnsignedInt(unsigned int index)
 {
 	unsigned int error = 0;
-	char code = 'u';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return static_cast<unsigned int>(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mBool);
 	case 'i':
-		return static_cast<unsigned int>(static_cast<Item<int>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mInt);
 	case 'f':
-		return static_cast<unsigned int>(static_cast<Item<float>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mFloat);
 	case 'd':
-		return static_cast<unsigned int>(static_cast<Item<double>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mDouble);
 	case 'c':
-		return static_cast<unsigned int>(static_cast<Item<char>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mChar);
 	case 'l':
-		return static_cast<unsigned int>(static_cast<Item<long>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mLong);
 	case 'u':
-		return static_cast<unsigned int>(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return static_cast<unsigned int>(item.mUnsignedInt);
 	case 's':
-		return static_cast<unsigned int>(atoi(static_cast<Item<std::string>*>(mItems[index])->mItem.c_str()));
+		return static_cast<unsigned int>(atoi(item.getString()));
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -462,40 +280,30 @@ unsigned int Tuple::getItemAsUnsignedInt(unsigned int index)
 std::string Tuple::getItemAsString(unsigned int index)
 {
 	std::string error = "";
-	char code = 's';
-	if (index >= mItems.size())
-	{
-		return error;
-	}
-	if (mCode[index] == 'v')
+	if (index >= mSize)
 	{
 		return error;
 	}
+	const Item& item = mItems[index];
 	switch (mCode[index])
 	{
 	case 'b':
-		return std::to_string(static_cast<Item<bool>*>(mItems[index])->mItem);
+		return std::to_string(item.mBool);
 	case 'i':
-		return std::to_string(static_cast<Item<int>*>(mItems[index])->mItem);
+		return std::to_string(item.mInt);
 	case 'f':
-		return std::to_string(static_cast<Item<float>*>(mItems[index])->mItem);
+		return std::to_string(item.mFloat);
 	case 'd':
-		return std::to_string(static_cast<Item<double>*>(mItems[index])->mItem);
+		return std::to_string(item.mDouble);
 	case 'c':
-		return std::to_string(static_cast<Item<char>*>(mItems[index])->mItem);
+		return std::to_string(item.mChar);
 	case 'l':
-		return std::to_string(static_cast<Item<long>*>(mItems[index])->mItem);
+		return std::to_string(item.mLong);
 	case 'u':
-		return std::to_string(static_cast<Item<unsigned int>*>(mItems[index])->mItem);
+		return std::to_string(item.mUnsignedInt);
 	case 's':
-		return static_cast<Item<std::string>*>(mItems[index])->mItem;
+		return std::string(item.getString(), item.getStringSize());
 	default:
-		if (index == mItems.size() - 1)
-		{
-			mCode = mCode.substr(0, index);
-			break;
-		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
 		break;
 	}
 	return error;
@@ -504,37 +312,273 @@ std::string Tuple::getItemAsString(unsigned int index)
 void* Tuple::getItemAsVoid(unsigned int index)
 {
 	void* error = nullptr;
-	char code = 'v';
-	if (index >= mItems.size())
+	if ((index >= mSize) || (mCode[index] != 'v'))
 	{
 		return error;
 	}
-	if (mCode[index] != 'v')
+	return mItems[index].mVoid;
+}
+
+unsigned int Tuple::getSize() const
+{
+	return mSize;
+}
+
+std::string Tuple::getCode() const
+{
+	return std::string(mCode, mSize);
+}
+
+char Tuple::getItemCode(unsigned int index) const
+{
+	if (index >= mSize)
 	{
-		return error;
+		return 0;
 	}
-	switch (mCode[index])
+	return mCode[index];
+}
+
+const Tuple::Item* Tuple::getItem(unsigned int index) const
+{
+	if (index >= mSize)
+	{
+		return nullptr;
+	}
+	return &mItems[index];
+}
+
+void Tuple::addItem(char code, const Item& item)
+{
+	if (mSize == mCapacity)
+	{
+		// items are plain unions, so they move over by copy along with the string buffers they own
+		Item* items = new Item[mCapacity * 2];
+		char* codes = new char[mCapacity * 2];
+		std::memcpy(items, mItems, mSize * sizeof(Item));
+		std::memcpy(codes, mCode, mSize);
+		if (mItems != mInlineItems)
+		{
+			delete[] mItems;
+			delete[] mCode;
+		}
+		mItems = items;
+		mCode = codes;
+		mCapacity *= 2;
+	}
+	mItems[mSize] = item;
+	mCode[mSize] = code;
+	++mSize;
+}
+
+std::size_t Tuple::getItemHash(unsigned int index) const
+{
+	if (index >= mSize)
+	{
+		return 0;
+	}
+	return hashItem(mCode[index], &mItems[index]);
+}
+
+void Tuple::append(const char* code, va_list* list)
+{
+	if (code == nullptr)
+	{
+		return;
+	}
+	for (; *code != '\0'; ++code)
+	{
+		Item item;
+		if (createItem(*code, list, item))
+		{
+			addItem(*code, item);
+		}
+	}
+}
+
+bool Tuple::createItem(char code, va_list* list, Item& item)
+{
+	switch (code)
 	{
+	case 'b':
+		item.mBool = (va_arg(*list, int)!=0);
+		return true;
+	case 'i':
+		item.mInt = va_arg(*list, int);
+		return true;
+	case 'f':
+		item.mFloat = static_cast<float>(va_arg(*list, double));
+		return true;
+	case 'd':
+		item.mDouble = va_arg(*list, double);
+		return true;
+	case 'c':
+		item.mChar = static_cast<char>(va_arg(*list, int));
+		return true;
+	case 'l':
+		item.mLong = va_arg(*list, long);
+		return true;
+	case 'u':
+		item.mUnsignedInt = static_cast<unsigned int>(va_arg(*list, int));
+		return true;
+	case 's':
+		{
+			const char* string = va_arg(*list, char*);
+			item.setString(string, (string == nullptr) ? 0 : std::strlen(string));
+		}
+		return true;
+	case 'v':
+		item.mVoid = va_arg(*list, void*);
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+void Tuple::copyItem(char code, const Item& source, Item& target)
+{
+	target = source;
+	if ((code == 's') && (static_cast<unsigned char>(source.mString[TUPLE_SHORT_STRING + 1]) == TUPLE_LONG_STRING))
+	{
+		source.mBuffer->mReferences.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void Tuple::destroyItem(char code, Item& item)
+{
+	if ((code != 's') || (static_cast<unsigned char>(item.mString[TUPLE_SHORT_STRING + 1]) != TUPLE_LONG_STRING))
+	{
+		return;
+	}
+	StringBuffer* buffer = item.mBuffer;
+	if (buffer->mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		buffer->~StringBuffer();
+		::operator delete(buffer);
+	}
+}
+
+bool Tuple::isItemEqual(char code, const Item* left, const Item* right)
+{
+	if ((left == nullptr) || (right == nullptr))
+	{
+		return false;
+	}
+	switch (code)
+	{
+	case 'b':
+		return (left->mBool == right->mBool);
+	case 'i':
+		return (left->mInt == right->mInt);
+	case 'f':
+		return (left->mFloat == right->mFloat);
+	case 'd':
+		return (left->mDouble == right->mDouble);
+	case 'c':
+		return (left->mChar == right->mChar);
+	case 'l':
+		return (left->mLong == right->mLong);
+	case 'u':
+		return (left->mUnsignedInt == right->mUnsignedInt);
+	case 's':
+		return ((left->getStringSize() == right->getStringSize()) && (std::memcmp(left->getString(), right->getString(), left->getStringSize()) == 0));
 	case 'v':
-		return static_cast<Item<void*>*>(mItems[index])->mItem;
+		return (left->mVoid == right->mVoid);
 	default:
-		if (index == mItems.size() - 1)
+		break;
+	}
+	return false;
+}
+
+std::size_t Tuple::hashItem(char code, const Item* item)
+{
+	std::size_t hash = 0;
+	if (item == nullptr)
+	{
+		return hash;
+	}
+	switch (code)
+	{
+	case 'b':
+		hash = std::hash<bool>()(item->mBool);
+		break;
+	case 'i':
+		hash = std::hash<int>()(item->mInt);
+		break;
+	case 'f':
+		hash = std::hash<float>()(item->mFloat);
+		break;
+	case 'd':
+		hash = std::hash<double>()(item->mDouble);
+		break;
+	case 'c':
+		hash = std::hash<char>()(item->mChar);
+		break;
+	case 'l':
+		hash = std::hash<long>()(item->mLong);
+		break;
+	case 'u':
+		hash = std::hash<unsigned int>()(item->mUnsignedInt);
+		break;
+	case 's':
 		{
-			mCode = mCode.substr(0, index);
-			break;
+			// FNV-1a, so that a long string is not copied just to be hashed
+			const char* string = item->getString();
+			std::size_t size = item->getStringSize();
+			hash = static_cast<std::size_t>(14695981039346656037ull);
+			for (std::size_t i = 0; i != size; ++i)
+			{
+				hash ^= static_cast<unsigned char>(string[i]);
+				hash *= static_cast<std::size_t>(1099511628211ull);
+			}
 		}
-		mCode = mCode.substr(0, index) + mCode.substr(index + 1);
+		break;
+	case 'v':
+		hash = std::hash<void*>()(item->mVoid);
+		break;
+	default:
 		break;
 	}
-	return error;
+	// values of different types that hash alike are spread apart by their code
+	return (hash * 31) + static_cast<unsigned char>(code);
 }
 
-unsigned int Tuple::getSize() const
+void Tuple::Item::setString(const char* data, std::size_t size)
 {
-	return mItems.size();
+	if (size <= TUPLE_SHORT_STRING)
+	{
+		if (size != 0)
+		{
+			std::memcpy(mString, data, size);
+		}
+		mString[size] = '\0';
+		mString[TUPLE_SHORT_STRING + 1] = static_cast<char>(size);
+		return;
+	}
+	void* memory = ::operator new(offsetof(StringBuffer, mData) + size + 1);
+	StringBuffer* buffer = new (memory) StringBuffer;
+	buffer->mReferences.store(1, std::memory_order_relaxed);
+	buffer->mSize = size;
+	std::memcpy(buffer->mData, data, size);
+	buffer->mData[size] = '\0';
+	mBuffer = buffer;
+	mString[TUPLE_SHORT_STRING + 1] = static_cast<char>(TUPLE_LONG_STRING);
 }
 
-const std::string& Tuple::getCode() const
+const char* Tuple::Item::getString() const
 {
-	return mCode;
+	if (static_cast<unsigned char>(mString[TUPLE_SHORT_STRING + 1]) == TUPLE_LONG_STRING)
+	{
+		return mBuffer->mData;
+	}
+	return mString;
+}
+
+std::size_t Tuple::Item::getStringSize() const
+{
+	if (static_cast<unsigned char>(mString[TUPLE_SHORT_STRING + 1]) == TUPLE_LONG_STRING)
+	{
+		return mBuffer->mSize;
+	}
+	return static_cast<unsigned char>(mString[TUPLE_SHORT_STRING + 1]);
 }
@@ -0,0 +1,548 @@
+#include <TupleSpace/TupleLog.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+/// Every log starts with this magic and a version number, padded to TUPLE_LOG_HEADER_SIZE bytes.
+#define TUPLE_LOG_MAGIC "TUPLELOG"
+#define TUPLE_LOG_VERSION 1
+#define TUPLE_LOG_HEADER_SIZE 16
+
+/// Each record is its payload size and checksum, followed by the payload. A zero size marks the end of the log.
+#define TUPLE_LOG_RECORD_HEADER_SIZE 8
+
+template<typename T> static void write(std::vector<unsigned char>& buffer, const T& value)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T> static bool read(const unsigned char*& data, const unsigned char* end, T& value)
+{
+	if (static_cast<std::size_t>(end - data) < sizeof(T))
+		return false;
+	std::memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+static bool isMissing(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return (errno == ENOENT);
+	std::fclose(file);
+	return false;
+}
+
+TupleLog::TupleLog() :
+	mEnd(0),
+	mFlushedEnd(0),
+	mCompactedEnd(0),
+	mAppended(0),
+	mCommitted(0),
+	mRequested(0),
+	mGeneration(0),
+	mFailed(false),
+	mRewriting(false),
+	mStop(false)
+{
+}
+
+TupleLog::~TupleLog()
+{
+	close();
+}
+
+bool TupleLog::open(const std::string& path, Contents& contents)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::lock_guard<std::mutex> flushLock(mFlushMutex);
+	if (mFile.isOpen())
+		return false;
+	if ((!mFile.open(path, true)) || (mFile.getSize() == 0))
+	{
+		// a log that is there but cannot be mapped is left alone rather than emptied
+		if ((!mFile.isOpen()) && (!isMissing(path)))
+			return false;
+		mFile.close();
+		if ((!writeFile(path, std::vector<unsigned char>())) || (!mFile.open(path, true)))
+			return false;
+	}
+
+	std::uint32_t version = 0;
+	if (mFile.getSize() >= TUPLE_LOG_HEADER_SIZE)
+		std::memcpy(&version, mFile.getData() + 8, sizeof(version));
+	if ((version != TUPLE_LOG_VERSION) || (std::memcmp(mFile.getData(), TUPLE_LOG_MAGIC, 8) != 0))
+	{
+		mFile.close();
+		return false;
+	}
+
+	mEnd = decode(mFile.getData(), mFile.getSize(), contents);
+	// whatever a crash tore off the end is cleared, so that new records are not followed by stale ones
+	std::memset(mFile.getData() + mEnd, 0, static_cast<std::size_t>(mFile.getSize() - mEnd));
+	mFlushedEnd = mEnd;
+	mCompactedEnd = mEnd;
+	mFailed = false;
+	mPath = path;
+	mThread = std::thread(&TupleLog::runCommits, this);
+	return true;
+}
+
+void TupleLog::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mThread.joinable())
+			return;
+		mStop = true;
+	}
+	mCommitCondition.notify_all();
+	mThread.join();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::lock_guard<std::mutex> flushLock(mFlushMutex);
+	if ((mEnd > mFlushedEnd) && (!mFile.flush(mFlushedEnd, mEnd - mFlushedEnd)))
+		mFailed = true;
+	mFile.close();
+	// the syncs still parked only succeed if everything they wait for made it to the file
+	if (!mFailed)
+		mCommitted = mAppended;
+	mStop = false;
+	mCompaction = nullptr;
+	mSyncCondition.notify_all();
+}
+
+bool TupleLog::isOpen()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mFile.isOpen();
+}
+
+std::uint64_t TupleLog::logPut(const std::string& tag, unsigned long long sequence, Tuple* t)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if ((!mFile.isOpen()) || (mFailed))
+		return 0;
+	mBuffer.clear();
+	encode(mBuffer, PUT, tag, sequence, t);
+	return append();
+}
+
+std::uint64_t TupleLog::logGet(const std::string& tag, unsigned long long sequence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if ((!mFile.isOpen()) || (mFailed))
+		return 0;
+	mBuffer.clear();
+	encode(mBuffer, GET, tag, sequence, nullptr);
+	return append();
+}
+
+bool TupleLog::sync(std::uint64_t position)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if (mCommitted >= position)
+		return true;
+	if ((!mFile.isOpen()) || (mFailed))
+		return false;
+	// the commit thread takes everything appended so far, so the syncs that pile up meanwhile share the next flush
+	if (position > mRequested)
+	{
+		mRequested = position;
+		mCommitCondition.notify_one();
+	}
+	mSyncCondition.wait(lock, [this, position]() { return (mCommitted >= position) || (!mFile.isOpen()) || (mFailed); });
+	return (mCommitted >= position);
+}
+
+bool TupleLog::beginRewrite()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if ((!mFile.isOpen()) || (mFailed) || (mRewriting))
+		return false;
+	mRewriting = true;
+	mRewriteBuffer.clear();
+	mCarried.clear();
+	return true;
+}
+
+void TupleLog::addEntry(const std::string& tag, unsigned long long sequence, Tuple* t)
+{
+	encode(mRewriteBuffer, PUT, tag, sequence, t);
+}
+
+bool TupleLog::endRewrite()
+{
+	std::string compacted;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		compacted = mPath + ".compact";
+	}
+
+	// the old log stays in place until the new one is complete and flushed, and takes appends meanwhile
+	bool written = writeFile(compacted, mRewriteBuffer);
+	std::uint64_t end = TUPLE_LOG_HEADER_SIZE + mRewriteBuffer.size();
+	std::vector<unsigned char>().swap(mRewriteBuffer);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::lock_guard<std::mutex> flushLock(mFlushMutex);
+	mRewriting = false;
+	if ((written) && (mFile.isOpen()) && (!mFailed) && (!mCarried.empty()))
+	{
+		// only the records appended since beginRewrite() are written under the lock
+		NFE::MappedFile file;
+		written = file.open(compacted, true);
+		std::uint64_t needed = end + mCarried.size() + TUPLE_LOG_RECORD_HEADER_SIZE;
+		if ((written) && (needed > file.getSize()))
+		{
+			std::uint64_t size = file.getSize() << 1;
+			while (size < needed)
+				size <<= 1;
+			written = file.resize(size);
+		}
+		if (written)
+		{
+			std::memcpy(file.getData() + end, mCarried.data(), mCarried.size());
+			written = file.flush(end, mCarried.size());
+			end += mCarried.size();
+		}
+	}
+	std::vector<unsigned char>().swap(mCarried);
+	if ((!written) || (!mFile.isOpen()) || (mFailed))
+	{
+		std::remove(compacted.c_str());
+		mCompactedEnd = mEnd;
+		return false;
+	}
+
+	mFile.close();
+#ifdef _WIN32
+	// Windows will not rename over an existing file
+	std::remove(mPath.c_str());
+#endif
+	bool renamed = (std::rename(compacted.c_str(), mPath.c_str()) == 0);
+	if (!mFile.open(mPath, true))
+	{
+		mSyncCondition.notify_all();
+		return false;
+	}
+	if (!renamed)
+	{
+		mCompactedEnd = mEnd;
+		return false;
+	}
+	mEnd = end;
+	mFlushedEnd = mEnd;
+	mCompactedEnd = mEnd;
+	mCommitted = mAppended;
+	++mGeneration;
+	mSyncCondition.notify_all();
+	return true;
+}
+
+void TupleLog::setCompaction(std::function<void()> compaction)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCompaction = compaction;
+}
+
+void TupleLog::encode(std::vector<unsigned char>& buffer, Type type, const std::string& tag, unsigned long long sequence, Tuple* t)
+{
+	std::size_t start = buffer.size();
+	buffer.resize(start + TUPLE_LOG_RECORD_HEADER_SIZE);
+	write(buffer, static_cast<std::uint8_t>(type));
+	write(buffer, static_cast<std::uint16_t>(tag.size()));
+	buffer.insert(buffer.end(), tag.begin(), tag.end());
+	write(buffer, static_cast<std::uint64_t>(sequence));
+
+	if (t != nullptr)
+	{
+		std::string code = t->getCode();
+		write(buffer, static_cast<std::uint16_t>(code.size()));
+		buffer.insert(buffer.end(), code.begin(), code.end());
+		for (unsigned int i = 0; i != code.size(); ++i)
+		{
+			const Tuple::Item* item = t->getItem(i);
+			switch (code[i])
+			{
+			case 'b':
+				write(buffer, static_cast<std::uint8_t>(item->mBool ? 1 : 0));
+				break;
+			case 'i':
+				write(buffer, static_cast<std::int32_t>(item->mInt));
+				break;
+			case 'f':
+				write(buffer, item->mFloat);
+				break;
+			case 'd':
+				write(buffer, item->mDouble);
+				break;
+			case 'c':
+				write(buffer, item->mChar);
+				break;
+			case 'l':
+				write(buffer, static_cast<std::int64_t>(item->mLong));
+				break;
+			case 'u':
+				write(buffer, static_cast<std::uint32_t>(item->mUnsignedInt));
+				break;
+			case 's':
+				write(buffer, static_cast<std::uint32_t>(item->getStringSize()));
+				buffer.insert(buffer.end(), item->getString(), item->getString() + item->getStringSize());
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	std::uint32_t size = static_cast<std::uint32_t>(buffer.size() - start - TUPLE_LOG_RECORD_HEADER_SIZE);
+	std::uint32_t checksum = getChecksum(buffer.data() + start + TUPLE_LOG_RECORD_HEADER_SIZE, size);
+	std::memcpy(buffer.data() + start, &size, sizeof(size));
+	std::memcpy(buffer.data() + start + sizeof(size), &checksum, sizeof(checksum));
+}
+
+std::uint64_t TupleLog::decode(const unsigned char* data, std::uint64_t size, Contents& contents)
+{
+	std::uint64_t position = TUPLE_LOG_HEADER_SIZE;
+	while (size - position >= TUPLE_LOG_RECORD_HEADER_SIZE)
+	{
+		std::uint32_t length;
+		std::uint32_t checksum;
+		std::memcpy(&length, data + position, sizeof(length));
+		std::memcpy(&checksum, data + position + sizeof(length), sizeof(checksum));
+		if ((length == 0) || (length > size - position - TUPLE_LOG_RECORD_HEADER_SIZE))
+			break;
+		const unsigned char* payload = data + position + TUPLE_LOG_RECORD_HEADER_SIZE;
+		if (getChecksum(payload, length) != checksum)
+			break;
+
+		const unsigned char* end = payload + length;
+		std::uint8_t type;
+		std::uint16_t tagSize;
+		std::uint64_t sequence;
+		if ((!read(payload, end, type)) || (!read(payload, end, tagSize)) || (static_cast<std::size_t>(end - payload) < tagSize))
+			break;
+		std::string tag(reinterpret_cast<const char*>(payload), tagSize);
+		payload += tagSize;
+		if (!read(payload, end, sequence))
+			break;
+
+		if (type == PUT)
+		{
+			Tuple* t = decodeTuple(payload, end);
+			if (t == nullptr)
+				break;
+			Tuple*& slot = contents[tag][sequence];
+			delete slot;
+			slot = t;
+		}
+		else if (type == GET)
+		{
+			Contents::iterator tuples = contents.find(tag);
+			if (tuples != contents.end())
+			{
+				std::map<unsigned long long, Tuple*>::iterator iter = tuples->second.find(sequence);
+				if (iter != tuples->second.end())
+				{
+					delete iter->second;
+					tuples->second.erase(iter);
+				}
+				if (tuples->second.empty())
+					contents.erase(tuples);
+			}
+		}
+		else
+		{
+			break;
+		}
+		position += TUPLE_LOG_RECORD_HEADER_SIZE + length;
+	}
+	return position;
+}
+
+Tuple* TupleLog::decodeTuple(const unsigned char*& data, const unsigned char* end)
+{
+	std::uint16_t codeSize;
+	if ((!read(data, end, codeSize)) || (static_cast<std::size_t>(end - data) < codeSize))
+		return nullptr;
+	std::string code(reinterpret_cast<const char*>(data), codeSize);
+	data += codeSize;
+
+	Tuple* t = new Tuple();
+	bool valid = true;
+	for (std::size_t i = 0; (valid) && (i != code.size()); ++i)
+	{
+		Tuple::Item item;
+		switch (code[i])
+		{
+		case 'b':
+			{
+				std::uint8_t value = 0;
+				valid = read(data, end, value);
+				item.mBool = (value != 0);
+			}
+			break;
+		case 'i':
+			{
+				std::int32_t value = 0;
+				valid = read(data, end, value);
+				item.mInt = value;
+			}
+			break;
+		case 'f':
+			item.mFloat = 0.0f;
+			valid = read(data, end, item.mFloat);
+			break;
+		case 'd':
+			item.mDouble = 0.0;
+			valid = read(data, end, item.mDouble);
+			break;
+		case 'c':
+			item.mChar = 0;
+			valid = read(data, end, item.mChar);
+			break;
+		case 'l':
+			{
+				std::int64_t value = 0;
+				valid = read(data, end, value);
+				item.mLong = static_cast<long>(value);
+			}
+			break;
+		case 'u':
+			{
+				std::uint32_t value = 0;
+				valid = read(data, end, value);
+				item.mUnsignedInt = value;
+			}
+			break;
+		case 's':
+			{
+				std::uint32_t size = 0;
+				valid = (read(data, end, size)) && (static_cast<std::size_t>(end - data) >= size);
+				if (!valid)
+					break;
+				item.setString(reinterpret_cast<const char*>(data), size);
+				data += size;
+			}
+			break;
+		case 'v':
+			item.mVoid = nullptr;
+			break;
+		default:
+			valid = false;
+			break;
+		}
+		if (valid)
+			t->addItem(code[i], item);
+	}
+	if (!valid)
+	{
+		delete t;
+		return nullptr;
+	}
+	return t;
+}
+
+std::uint32_t TupleLog::getChecksum(const unsigned char* data, std::size_t size)
+{
+	// FNV-1a, which is plenty to tell a torn record from a whole one
+	std::uint32_t hash = 2166136261u;
+	for (std::size_t i = 0; i != size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool TupleLog::writeFile(const std::string& path, const std::vector<unsigned char>& records)
+{
+	std::uint64_t size = TUPLE_LOG_INITIAL_SIZE;
+	while (size < TUPLE_LOG_HEADER_SIZE + records.size() + TUPLE_LOG_RECORD_HEADER_SIZE)
+		size <<= 1;
+	NFE::MappedFile file;
+	if (!file.create(path, size))
+		return false;
+	std::uint32_t version = TUPLE_LOG_VERSION;
+	std::memcpy(file.getData(), TUPLE_LOG_MAGIC, 8);
+	std::memcpy(file.getData() + 8, &version, sizeof(version));
+	if (!records.empty())
+		std::memcpy(file.getData() + TUPLE_LOG_HEADER_SIZE, records.data(), records.size());
+	return file.flush();
+}
+
+std::uint64_t TupleLog::append()
+{
+	// there is always room left for the zero size that ends the log
+	std::uint64_t needed = mEnd + mBuffer.size() + TUPLE_LOG_RECORD_HEADER_SIZE;
+	if (needed > mFile.getSize())
+	{
+		std::uint64_t size = mFile.getSize() << 1;
+		while (size < needed)
+			size <<= 1;
+		std::lock_guard<std::mutex> flushLock(mFlushMutex);
+		if (!mFile.resize(size))
+		{
+			// a record left out would make the replay disagree with every later one, so the log stops here
+			mFailed = true;
+			mSyncCondition.notify_all();
+			return 0;
+		}
+	}
+	std::memcpy(mFile.getData() + mEnd, mBuffer.data(), mBuffer.size());
+	if (mRewriting)
+		mCarried.insert(mCarried.end(), mBuffer.begin(), mBuffer.end());
+	mEnd += mBuffer.size();
+	mAppended += mBuffer.size();
+	return mAppended;
+}
+
+void TupleLog::runCommits()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mStop)
+	{
+		mCommitCondition.wait_for(lock, std::chrono::milliseconds(TUPLE_LOG_COMMIT_PERIOD), [this]() { return (mStop) || ((mRequested > mCommitted) && (!mFailed)); });
+		if (mStop)
+			break;
+
+		if ((mAppended != mCommitted) && (!mFailed))
+		{
+			std::uint64_t appended = mAppended;
+			std::uint64_t start = mFlushedEnd;
+			std::uint64_t end = mEnd;
+			unsigned long long generation = mGeneration;
+			bool flushed = true;
+			lock.unlock();
+			{
+				// appends carry on meanwhile, they only wait when the file has to grow
+				std::lock_guard<std::mutex> flushLock(mFlushMutex);
+				if ((generation == mGeneration) && (end > start))
+					flushed = mFile.flush(start, end - start);
+			}
+			lock.lock();
+			if (!flushed)
+				mFailed = true;
+			else
+			{
+				if ((generation == mGeneration) && (end > mFlushedEnd))
+					mFlushedEnd = end;
+				if (appended > mCommitted)
+					mCommitted = appended;
+			}
+			mSyncCondition.notify_all();
+		}
+
+		if ((mCompaction) && (mEnd > TUPLE_LOG_COMPACT_SIZE) && (mEnd > 2 * mCompactedEnd))
+		{
+			std::function<void()> compaction = mCompaction;
+			lock.unlock();
+			compaction();
+			lock.lock();
+		}
+	}
+}
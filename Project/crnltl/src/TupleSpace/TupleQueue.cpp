@@ -0,0 +1,146 @@
+#include <TupleSpace/TupleQueue.hpp>
+
+TupleQueue::Pool::Pool() :
+	mSpares(nullptr),
+	mSpareCount(0),
+	mUsedCount(0),
+	mHighWater(0),
+	mReleaseCount(0)
+{
+}
+
+TupleQueue::Pool::~Pool()
+{
+	while (mSpares != nullptr)
+	{
+		Chunk* chunk = mSpares;
+		mSpares = chunk->mNext;
+		delete chunk;
+	}
+	mSpareCount = 0;
+}
+
+TupleQueue::Chunk* TupleQueue::Pool::acquire()
+{
+	Chunk* chunk = mSpares;
+	if (chunk != nullptr)
+	{
+		mSpares = chunk->mNext;
+		--mSpareCount;
+	}
+	else
+	{
+		chunk = new Chunk();
+	}
+	chunk->mNext = nullptr;
+	++mUsedCount;
+	if (mUsedCount > mHighWater)
+		mHighWater = mUsedCount;
+	return chunk;
+}
+
+void TupleQueue::Pool::release(Chunk* chunk)
+{
+	chunk->mNext = mSpares;
+	mSpares = chunk;
+	++mSpareCount;
+	--mUsedCount;
+	++mReleaseCount;
+	if (mReleaseCount == TUPLE_QUEUE_TRIM_PERIOD)
+		trim();
+}
+
+void TupleQueue::Pool::trim()
+{
+	// a burst bigger than the steady state only keeps its chunks for one period
+	std::size_t keep = mHighWater - mUsedCount;
+	while (mSpareCount > keep)
+	{
+		Chunk* chunk = mSpares;
+		mSpares = chunk->mNext;
+		delete chunk;
+		--mSpareCount;
+	}
+	mHighWater = mUsedCount;
+	mReleaseCount = 0;
+}
+
+std::size_t TupleQueue::Pool::getSpareCount() const
+{
+	return mSpareCount;
+}
+
+std::size_t TupleQueue::Pool::getUsedCount() const
+{
+	return mUsedCount;
+}
+
+TupleQueue::TupleQueue(Pool* pool) :
+	mPool(pool),
+	mBegin(0),
+	mSize(0)
+{
+}
+
+TupleQueue::~TupleQueue()
+{
+	for (std::size_t i = 0; i != mChunks.size(); ++i)
+		mPool->release(mChunks[i]);
+	mChunks.clear();
+}
+
+void TupleQueue::push_back(Tuple* t)
+{
+	std::size_t end = mBegin + mSize;
+	if (end == mChunks.size() * TUPLE_QUEUE_CHUNK_SIZE)
+		mChunks.push_back(mPool->acquire());
+	mChunks[end / TUPLE_QUEUE_CHUNK_SIZE]->mSlots[end % TUPLE_QUEUE_CHUNK_SIZE] = t;
+	++mSize;
+}
+
+void TupleQueue::pop_front()
+{
+	++mBegin;
+	--mSize;
+	if (mSize == 0)
+	{
+		// the first chunk is kept for the next put
+		for (std::size_t i = 1; i != mChunks.size(); ++i)
+			mPool->release(mChunks[i]);
+		mChunks.resize(1);
+		mBegin = 0;
+	}
+	else if (mBegin == TUPLE_QUEUE_CHUNK_SIZE)
+	{
+		mPool->release(mChunks.front());
+		mChunks.erase(mChunks.begin());
+		mBegin = 0;
+	}
+}
+
+Tuple*& TupleQueue::front()
+{
+	return mChunks.front()->mSlots[mBegin];
+}
+
+Tuple*& TupleQueue::operator[](std::size_t position)
+{
+	std::size_t index = mBegin + position;
+	return mChunks[index / TUPLE_QUEUE_CHUNK_SIZE]->mSlots[index % TUPLE_QUEUE_CHUNK_SIZE];
+}
+
+std::chrono::steady_clock::time_point& TupleQueue::getStamp(std::size_t position)
+{
+	std::size_t index = mBegin + position;
+	return mChunks[index / TUPLE_QUEUE_CHUNK_SIZE]->mStamps[index % TUPLE_QUEUE_CHUNK_SIZE];
+}
+
+bool TupleQueue::empty() const
+{
+	return (mSize == 0);
+}
+
+std::size_t TupleQueue::size() const
+{
+	return mSize;
+}
@@ -0,0 +1,177 @@
+#include <TupleSpace/TupleRing.hpp>
+
+TupleRing::TupleRing(Mode mode, unsigned int capacity) :
+	mMode(mode),
+	mTail(0),
+	mCachedHead(0),
+	mHead(0),
+	mCachedTail(0)
+{
+	std::size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+	mMask = size - 1;
+	mSlots = new Slot[size];
+	for (std::size_t i = 0; i != size; ++i)
+	{
+		mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+		mSlots[i].mTuple = nullptr;
+	}
+}
+
+TupleRing::~TupleRing()
+{
+	Tuple* t = pop();
+	while (t != nullptr)
+	{
+		delete t;
+		t = pop();
+	}
+	delete[] mSlots;
+}
+
+bool TupleRing::push(Tuple* t)
+{
+	if (mMode == SPSC)
+	{
+		std::size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mCachedHead > mMask)
+		{
+			mCachedHead = mHead.load(std::memory_order_acquire);
+			if (tail - mCachedHead > mMask)
+				return false;
+		}
+		mSlots[tail & mMask].mTuple = t;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// a slot is free for the producer that claims position p once its sequence reads p
+	std::size_t tail = mTail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot& slot = mSlots[tail & mMask];
+		std::size_t sequence = slot.mSequence.load(std::memory_order_acquire);
+		std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(tail);
+		if (difference == 0)
+		{
+			if (mTail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+			{
+				slot.mTuple = t;
+				slot.mSequence.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			tail = mTail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+std::size_t TupleRing::push(Tuple* const* tuples, std::size_t count)
+{
+	if (mMode == SPSC)
+	{
+		// the whole batch is published by a single store of the tail
+		std::size_t tail = mTail.load(std::memory_order_relaxed);
+		std::size_t space = mMask + 1 - (tail - mCachedHead);
+		if (space < count)
+		{
+			mCachedHead = mHead.load(std::memory_order_acquire);
+			space = mMask + 1 - (tail - mCachedHead);
+		}
+		if (count > space)
+			count = space;
+		for (std::size_t i = 0; i != count; ++i)
+			mSlots[(tail + i) & mMask].mTuple = tuples[i];
+		mTail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	std::size_t pushed = 0;
+	while ((pushed != count) && (push(tuples[pushed])))
+		++pushed;
+	return pushed;
+}
+
+Tuple* TupleRing::pop()
+{
+	std::size_t head = mHead.load(std::memory_order_relaxed);
+	if (mMode == SPSC)
+	{
+		if (head == mCachedTail)
+		{
+			mCachedTail = mTail.load(std::memory_order_acquire);
+			if (head == mCachedTail)
+				return nullptr;
+		}
+		Tuple* t = mSlots[head & mMask].mTuple;
+		mHead.store(head + 1, std::memory_order_release);
+		return t;
+	}
+
+	Slot& slot = mSlots[head & mMask];
+	if (slot.mSequence.load(std::memory_order_acquire) != head + 1)
+		return nullptr;
+	Tuple* t = slot.mTuple;
+	// hands the slot back to the producers one lap later
+	slot.mSequence.store(head + mMask + 1, std::memory_order_release);
+	mHead.store(head + 1, std::memory_order_relaxed);
+	return t;
+}
+
+std::size_t TupleRing::pop(std::vector<Tuple*>& out, std::size_t max)
+{
+	if (mMode == SPSC)
+	{
+		std::size_t head = mHead.load(std::memory_order_relaxed);
+		if (mCachedTail - head < max)
+			mCachedTail = mTail.load(std::memory_order_acquire);
+		std::size_t count = mCachedTail - head;
+		if (count > max)
+			count = max;
+		for (std::size_t i = 0; i != count; ++i)
+			out.push_back(mSlots[(head + i) & mMask].mTuple);
+		mHead.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	std::size_t popped = 0;
+	Tuple* t = nullptr;
+	while ((popped != max) && ((t = pop()) != nullptr))
+	{
+		out.push_back(t);
+		++popped;
+	}
+	return popped;
+}
+
+bool TupleRing::isEmpty() const
+{
+	std::size_t head = mHead.load(std::memory_order_relaxed);
+	if (mMode == SPSC)
+		return (head == mTail.load(std::memory_order_acquire));
+	return (mSlots[head & mMask].mSequence.load(std::memory_order_acquire) != head + 1);
+}
+
+std::size_t TupleRing::getSize() const
+{
+	std::size_t head = mHead.load(std::memory_order_relaxed);
+	std::size_t tail = mTail.load(std::memory_order_relaxed);
+	return ((tail > head) ? (tail - head) : 0);
+}
+
+TupleRing::Mode TupleRing::getMode() const
+{
+	return mMode;
+}
+
+unsigned int TupleRing::getCapacity() const
+{
+	return static_cast<unsigned int>(mMask + 1);
+}
@@ -1,25 +1,39 @@
 #include <TupleSpace/TupleSpace.hpp>
 #include <SFML3D/Network/Packet.hpp>
+#include <fstream>
+#include <iostream>
 
 TupleSpace* TupleSpace::mSingletonPtr = nullptr;
 
-TupleSpace::TupleSpace()
+TupleSpace::TupleSpace() :
+    mMetricsEnabled(false),
+    mDumpStop(false)
 {
+    for (unsigned int i = 0; i != TUPLE_SPACE_RING_COUNT; ++i)
+        mRings[i].store(nullptr);
     mSingletonPtr = this;
 }
 
 TupleSpace::~TupleSpace()
 {
-	for (std::map<std::string, std::queue<Tuple*>*>::iterator iter = mSpace.begin(); iter != mSpace.end(); ++iter)
+	setMetricsDump(std::string(), std::chrono::milliseconds(0));
+	closeLog();
+	for (unsigned int i = 0; i != TUPLE_SPACE_SHARD_COUNT; ++i)
 	{
-		while (!iter->second->empty())
+		std::unordered_map<TagId, Channel*>& space = mShards[i].mSpace;
+		for (std::unordered_map<TagId, Channel*>::iterator iter = space.begin(); iter != space.end(); ++iter)
 		{
-			delete iter->second->front();
-			iter->second->pop();
+			for (std::size_t j = 0; j != iter->second->mQueue.size(); ++j)
+				delete iter->second->mQueue[j];
+			delete iter->second;
 		}
-		delete iter->second;
+		space.clear();
+	}
+	for (unsigned int i = 0; i != TUPLE_SPACE_RING_COUNT; ++i)
+	{
+		delete mRings[i].load();
+		mRings[i].store(nullptr);
 	}
-	mSpace.clear();
 }
 
 TupleSpace* TupleSpace::getSingletonPtr()
@@ -27,64 +41,1101 @@ TupleSpace* TupleSpace::getSingletonPtr()
     return mSingletonPtr;
 }
 
-void TupleSpace::put(const std::string& tag, Tuple * t)
+bool TupleSpace::put(const std::string& tag, Tuple * t)
+{
+	return put(intern(tag), t);
+}
+
+bool TupleSpace::put(TagId tag, Tuple * t)
 {
-	mMutex.lock();
-	std::map<std::string, std::queue<Tuple*>*>::iterator iter = mSpace.find(tag);
-	if (iter == mSpace.end())
-		mSpace[tag] = new std::queue<Tuple*>();
-	mSpace[tag]->push(t);
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+	{
+		if (!ring->mRing.push(t))
+			return (push(tag, ring, &t, 1) == 1);
+		signal(tag, ring);
+		countPuts(ring, 1);
+		return true;
+	}
+
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	Channel* channel = getChannel(shard, tag);
+	lock.charge(channel);
+	unsigned long long sequence = 0;
+	if (admit(channel, lock, &t, 1, &sequence) == 0)
+		return false;
 
-	if (mListenerRegistry.find(tag) != mListenerRegistry.end())
-		ReleaseSemaphore(mListenerRegistry[tag], 1, nullptr);
+	// one tuple can only satisfy one waiter, but only a template can tell which
+	if (channel->mMatcherCount != 0)
+		channel->mCondition.notify_all();
+	else if (channel->mWaiterCount != 0)
+		channel->mCondition.notify_one();
 
-	mMutex.unlock();
+	std::uint64_t commit = getCommit(channel);
+	lock.unlock();
+	if ((commit != 0) && (!mLog.sync(commit)))
+		return (withdraw(shard, tag, &t, &sequence, 1) != 0);
+	return true;
+}
+
+std::size_t TupleSpace::putMany(const std::string& tag, const std::vector<Tuple*>& tuples)
+{
+	return putMany(intern(tag), tuples);
+}
+
+std::size_t TupleSpace::putMany(TagId tag, const std::vector<Tuple*>& tuples)
+{
+	if (tuples.empty())
+		return 0;
+
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+		return push(tag, ring, tuples.data(), tuples.size());
+
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	Channel* channel = getChannel(shard, tag);
+	lock.charge(channel);
+	std::vector<unsigned long long> sequences;
+	if (channel->mDurability == SYNCED)
+		sequences.resize(tuples.size());
+	std::size_t taken = admit(channel, lock, tuples.data(), tuples.size(), sequences.empty() ? nullptr : sequences.data());
+
+	if (channel->mWaiterCount != 0)
+	{
+		if ((tuples.size() == 1) && (channel->mMatcherCount == 0))
+			channel->mCondition.notify_one();
+		else
+			channel->mCondition.notify_all();
+	}
+
+	std::uint64_t commit = getCommit(channel);
+	lock.unlock();
+	if ((commit != 0) && (!mLog.sync(commit)) && (!sequences.empty()))
+		taken = withdraw(shard, tag, tuples.data(), sequences.data(), taken);
+	return taken;
+}
+
+std::size_t TupleSpace::drain(const std::string& tag, std::vector<Tuple*>& out, std::size_t max)
+{
+	return drain(intern(tag), out, max);
+}
+
+std::size_t TupleSpace::drain(TagId tag, std::vector<Tuple*>& out, std::size_t max)
+{
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+	{
+		std::size_t taken = ring->mRing.pop(out, max);
+		if (taken != 0)
+			release(tag, ring);
+		countGets(ring, taken);
+		return taken;
+	}
+
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+	if (iter == shard.mSpace.end())
+		return 0;
+	Channel* channel = iter->second;
+	lock.charge(channel);
+	std::size_t count = 0;
+	while ((count != max) && (!channel->mQueue.empty()))
+	{
+		out.push_back(remove(channel, 0));
+		++count;
+	}
+	return count;
 }
 
 Tuple * TupleSpace::get(const std::string& tag)
 {
-	mMutex.lock();
-	std::map<std::string, std::queue<Tuple*>*>::iterator iter = mSpace.find(tag);
-	if (iter == mSpace.end())
+	return get(intern(tag));
+}
+
+Tuple * TupleSpace::get(TagId tag)
+{
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
 	{
-		mMutex.unlock();
+		Tuple * t = ring->mRing.pop();
+		if (t != nullptr)
+		{
+			release(tag, ring);
+			countGets(ring, 1);
+		}
+		return t;
+	}
+
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+	if (iter == shard.mSpace.end())
 		return nullptr;
+	lock.charge(iter->second);
+	if (iter->second->mQueue.empty())
+		return nullptr;
+	return remove(iter->second, 0);
+}
+
+Tuple * TupleSpace::get(const std::string& tag, std::chrono::microseconds timeout)
+{
+	return get(intern(tag), timeout);
+}
+
+Tuple * TupleSpace::get(TagId tag, std::chrono::microseconds timeout)
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	return wait(shard, tag, lock, &deadline);
+}
+
+Tuple * TupleSpace::waitFor(const std::string& tag)
+{
+	return waitFor(intern(tag));
+}
+
+Tuple * TupleSpace::waitFor(TagId tag)
+{
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	return wait(shard, tag, lock, nullptr);
+}
+
+void TupleSpace::interrupt(TagId tag)
+{
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+	{
+		++ring->mInterruptCount;
+		ring->mCondition.notify_all();
+		ring->mSpaceCondition.notify_all();
+		return;
 	}
-	Tuple * t = iter->second->front();
-	iter->second->pop();
-	if (iter->second->empty())
+	std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+	if (iter == shard.mSpace.end())
+		return;
+	++iter->second->mInterruptCount;
+	iter->second->mCondition.notify_all();
+	iter->second->mSpaceCondition.notify_all();
+}
+
+bool TupleSpace::setCapacity(const std::string& tag, unsigned int capacity, Overflow overflow)
+{
+	return setCapacity(intern(tag), capacity, overflow);
+}
+
+bool TupleSpace::setCapacity(TagId tag, unsigned int capacity, Overflow overflow)
+{
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	if (getRing(tag) != nullptr)
+		return false;
+	Channel* channel = getChannel(shard, tag);
+	channel->mCapacity = capacity;
+	channel->mOverflow = overflow;
+
+	// the tuples already queued past a smaller capacity stay, a larger one lets blocked producers through
+	channel->mSpaceCondition.notify_all();
+	return true;
+}
+
+unsigned long long TupleSpace::getDropCount(TagId tag)
+{
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+		return ring->mDropCount.load();
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+	if (iter == shard.mSpace.end())
+		return 0;
+	return iter->second->mDropCount;
+}
+
+std::chrono::microseconds TupleSpace::getBlockedTime(TagId tag)
+{
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+		return std::chrono::microseconds(ring->mBlockedTime.load());
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+	if (iter == shard.mSpace.end())
+		return std::chrono::microseconds(0);
+	return std::chrono::duration_cast<std::chrono::microseconds>(iter->second->mBlockedTime);
+}
+
+bool TupleSpace::registerTag(const std::string& tag, TupleRing::Mode mode, unsigned int capacity, Overflow overflow)
+{
+	return registerTag(intern(tag), mode, capacity, overflow);
+}
+
+bool TupleSpace::registerTag(TagId tag, TupleRing::Mode mode, unsigned int capacity, Overflow overflow)
+{
+	if ((tag >= TUPLE_SPACE_RING_COUNT) || (overflow == DROP_OLDEST))
+		return false;
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	if ((mRings[tag].load() != nullptr) || (shard.mSpace.find(tag) != shard.mSpace.end()))
+		return false;
+	mRings[tag].store(new RingChannel(mode, capacity, overflow), std::memory_order_release);
+	return true;
+}
+
+bool TupleSpace::out(const std::string& tag, Tuple * t)
+{
+	return put(intern(tag), t);
+}
+
+bool TupleSpace::out(TagId tag, Tuple * t)
+{
+	return put(tag, t);
+}
+
+Tuple * TupleSpace::in(const std::string& tag, const TupleTemplate& pattern)
+{
+	return match(intern(tag), pattern, true, true);
+}
+
+Tuple * TupleSpace::in(TagId tag, const TupleTemplate& pattern)
+{
+	return match(tag, pattern, true, true);
+}
+
+Tuple * TupleSpace::inp(const std::string& tag, const TupleTemplate& pattern)
+{
+	return match(intern(tag), pattern, true, false);
+}
+
+Tuple * TupleSpace::inp(TagId tag, const TupleTemplate& pattern)
+{
+	return match(tag, pattern, true, false);
+}
+
+Tuple * TupleSpace::rd(const std::string& tag, const TupleTemplate& pattern)
+{
+	return match(intern(tag), pattern, false, true);
+}
+
+Tuple * TupleSpace::rd(TagId tag, const TupleTemplate& pattern)
+{
+	return match(tag, pattern, false, true);
+}
+
+Tuple * TupleSpace::rdp(const std::string& tag, const TupleTemplate& pattern)
+{
+	return match(intern(tag), pattern, false, false);
+}
+
+Tuple * TupleSpace::rdp(TagId tag, const TupleTemplate& pattern)
+{
+	return match(tag, pattern, false, false);
+}
+
+bool TupleSpace::addIndex(const std::string& tag, unsigned int field)
+{
+	return addIndex(intern(tag), field);
+}
+
+bool TupleSpace::addIndex(TagId tag, unsigned int field)
+{
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	if (getRing(tag) != nullptr)
+		return false;
+	Channel* channel = getChannel(shard, tag);
+	for (std::size_t i = 0; i != channel->mIndexes.size(); ++i)
 	{
-		delete iter->second;
-		mSpace.erase(iter);
+		if (channel->mIndexes[i].mField == field)
+			return true;
 	}
-	mMutex.unlock();
-	return t;
+	channel->mIndexes.push_back(Index());
+	Index& index = channel->mIndexes.back();
+	index.mField = field;
+	for (std::size_t i = 0; i != channel->mQueue.size(); ++i)
+	{
+		Tuple * t = channel->mQueue[i];
+		if ((t != nullptr) && (field < t->getSize()))
+			index.mEntries[t->getItemHash(field)].push_back(channel->mFirst + i);
+	}
+	return true;
 }
 
-bool TupleSpace::registerBlockingListener(std::string tag, HANDLE semaphore)
+bool TupleSpace::openLog(const std::string& path)
 {
-	mMutex.lock();
+	// what came back from the log under a tag, so it can leave again if the log cannot take it.
+	struct Restored
+	{
+		TagId mTag;
+		bool mMadeLogged;
+		std::vector<Tuple*> mTuples;
+		std::vector<unsigned long long> mSequences;
+	};
 
-	if (mListenerRegistry.find(tag) == mListenerRegistry.end())
+	TupleLog::Contents contents;
+	if (!mLog.open(path, contents))
+		return false;
+	std::vector<Restored> restored;
+	for (TupleLog::Contents::iterator iter = contents.begin(); iter != contents.end(); ++iter)
 	{
-		mListenerRegistry.insert(std::pair<std::string, HANDLE>(tag, semaphore));
-		mMutex.unlock();
+		TagId tag = intern(iter->first);
+		Shard& shard = getShard(tag);
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		std::map<unsigned long long, Tuple*>& tuples = iter->second;
+		if (getRing(tag) != nullptr)
+		{
+			// the tag has been registered as a ring since, which cannot hold on to them
+			for (std::map<unsigned long long, Tuple*>::iterator tuple = tuples.begin(); tuple != tuples.end(); ++tuple)
+				delete tuple->second;
+			continue;
+		}
+
+		// the tuples come back under new sequence numbers, which only the compaction below writes to the log
+		Channel* channel = getChannel(shard, tag);
+		restored.push_back(Restored());
+		Restored& entry = restored.back();
+		entry.mTag = tag;
+		entry.mMadeLogged = (channel->mDurability == MEMORY);
+		for (std::map<unsigned long long, Tuple*>::iterator tuple = tuples.begin(); tuple != tuples.end(); ++tuple)
+		{
+			entry.mSequences.push_back(channel->mFirst + channel->mQueue.size());
+			entry.mTuples.push_back(tuple->second);
+			append(channel, tuple->second, false);
+		}
+		if (entry.mMadeLogged)
+		{
+			channel->mDurability = LOGGED;
+			channel->mLogName = iter->first;
+		}
+		if (channel->mWaiterCount != 0)
+			channel->mCondition.notify_all();
+	}
+
+	// only set once the tuples are back, as a compaction keeps nothing but what is queued
+	mLog.setCompaction([this]() { compactLog(); });
+	if (compactLog())
 		return true;
-	} else
+
+	// the log still holds the tuples under their old sequence numbers, so they are taken back out of the tags rather than left to be logged twice
+	mLog.close();
+	for (std::size_t i = 0; i != restored.size(); ++i)
+	{
+		Restored& entry = restored[i];
+		Shard& shard = getShard(entry.mTag);
+		std::size_t left = withdraw(shard, entry.mTag, entry.mTuples.data(), entry.mSequences.data(), entry.mTuples.size());
+		for (std::size_t j = left; j != entry.mTuples.size(); ++j)
+			delete entry.mTuples[j];
+		if (entry.mMadeLogged)
+		{
+			std::lock_guard<std::mutex> lock(shard.mMutex);
+			Channel* channel = getChannel(shard, entry.mTag);
+			channel->mDurability = MEMORY;
+			channel->mLogName.clear();
+		}
+	}
+	return false;
+}
+
+void TupleSpace::closeLog()
+{
+	mLog.close();
+}
+
+bool TupleSpace::setDurability(const std::string& tag, Durability durability)
+{
+	return setDurability(intern(tag), durability);
+}
+
+bool TupleSpace::setDurability(TagId tag, Durability durability)
+{
+	std::string name = getTagName(tag);
+	Shard& shard = getShard(tag);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	if (getRing(tag) != nullptr)
+		return false;
+	Channel* channel = getChannel(shard, tag);
+	if ((channel->mDurability == MEMORY) != (durability == MEMORY))
 	{
-		mMutex.unlock();
+		// the tuples already queued join or leave the log along with the tag
+		for (std::size_t i = 0; i != channel->mQueue.size(); ++i)
+		{
+			if (channel->mQueue[i] == nullptr)
+				continue;
+			if (durability == MEMORY)
+				channel->mLogPosition = mLog.logGet(channel->mLogName, channel->mFirst + i);
+			else
+				channel->mLogPosition = mLog.logPut(name, channel->mFirst + i, channel->mQueue[i]);
+		}
+	}
+	channel->mDurability = durability;
+	channel->mLogName = name;
+	return true;
+}
+
+bool TupleSpace::compactLog()
+{
+	if (!mLog.isOpen())
 		return false;
+
+	{
+		// every shard is locked, in order, so that the log cannot change while its tuples are encoded
+		std::vector<std::unique_lock<std::mutex>> locks;
+		for (unsigned int i = 0; i != TUPLE_SPACE_SHARD_COUNT; ++i)
+			locks.push_back(std::unique_lock<std::mutex>(mShards[i].mMutex));
+		if (!mLog.beginRewrite())
+			return false;
+
+		for (unsigned int i = 0; i != TUPLE_SPACE_SHARD_COUNT; ++i)
+		{
+			std::unordered_map<TagId, Channel*>& space = mShards[i].mSpace;
+			for (std::unordered_map<TagId, Channel*>::iterator iter = space.begin(); iter != space.end(); ++iter)
+			{
+				Channel* channel = iter->second;
+				if (channel->mDurability == MEMORY)
+					continue;
+				for (std::size_t j = 0; j != channel->mQueue.size(); ++j)
+				{
+					if (channel->mQueue[j] != nullptr)
+						mLog.addEntry(channel->mLogName, channel->mFirst + j, channel->mQueue[j]);
+				}
+			}
+		}
+	}
+
+	// the file is written with no shard locked, while the puts and gets meanwhile are carried over to it
+	return mLog.endRewrite();
+}
+
+TupleSpace::TagId TupleSpace::intern(const std::string& tag)
+{
+	{
+		std::shared_lock<std::shared_timed_mutex> lock(mTagMutex);
+		std::unordered_map<std::string, TagId>::const_iterator iter = mTags.find(tag);
+		if (iter != mTags.end())
+			return iter->second;
+	}
+	std::unique_lock<std::shared_timed_mutex> lock(mTagMutex);
+	std::unordered_map<std::string, TagId>::const_iterator iter = mTags.find(tag);
+	if (iter != mTags.end())
+		return iter->second;
+	TagId id = static_cast<TagId>(mTagNames.size());
+	mTags.insert(std::pair<std::string, TagId>(tag, id));
+	mTagNames.push_back(tag);
+	return id;
+}
+
+std::string TupleSpace::getTagName(TagId tag)
+{
+	std::shared_lock<std::shared_timed_mutex> lock(mTagMutex);
+	if (tag >= mTagNames.size())
+		return std::string();
+	return mTagNames[tag];
+}
+
+TupleSpace::Shard& TupleSpace::getShard(TagId tag)
+{
+	// ids are dense, so consecutive tags land on distinct shards
+	return mShards[tag % TUPLE_SPACE_SHARD_COUNT];
+}
+
+TupleSpace::Channel* TupleSpace::getChannel(Shard& shard, TagId tag)
+{
+	Channel*& channel = shard.mSpace[tag];
+	if (channel == nullptr)
+		channel = new Channel(&shard.mPool);
+	return channel;
+}
+
+TupleSpace::RingChannel* TupleSpace::getRing(TagId tag)
+{
+	if (tag >= TUPLE_SPACE_RING_COUNT)
+		return nullptr;
+	return mRings[tag].load(std::memory_order_acquire);
+}
+
+void TupleSpace::release(TagId tag, RingChannel* ring, bool locked)
+{
+	// pairs with the fence of a producer about to park, as in signal()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (ring->mSpaceWaiterCount.load(std::memory_order_relaxed) == 0)
+		return;
+	if (locked)
+	{
+		ring->mSpaceCondition.notify_all();
+		return;
+	}
+	std::lock_guard<std::mutex> lock(getShard(tag).mMutex);
+	ring->mSpaceCondition.notify_all();
+}
+
+void TupleSpace::signal(TagId tag, RingChannel* ring)
+{
+	// pairs with the fence of a consumer about to wait, so that either it sees the tuples or this sees the waiter
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (ring->mWaiterCount.load(std::memory_order_relaxed) != 0)
+	{
+		std::lock_guard<std::mutex> lock(getShard(tag).mMutex);
+		ring->mCondition.notify_one();
 	}
 }
 
-void TupleSpace::unregisterBlockingListener(std::string tag)
+std::size_t TupleSpace::push(TagId tag, RingChannel* ring, Tuple* const* tuples, std::size_t count)
 {
-	mMutex.lock();
+	std::size_t pushed = ring->mRing.push(tuples, count);
+	if (pushed != 0)
+	{
+		signal(tag, ring);
+		countPuts(ring, pushed);
+	}
+	if (pushed == count)
+		return count;
 
-	std::map<std::string, HANDLE>::const_iterator loc = mListenerRegistry.find(tag);
+	switch (ring->mOverflow)
+	{
+	case DROP_NEWEST:
+		for (std::size_t i = pushed; i != count; ++i)
+			delete tuples[i];
+		ring->mDropCount.fetch_add(count - pushed);
+		return count;
+	case FAIL:
+		ring->mDropCount.fetch_add(count - pushed);
+		return pushed;
+	default:
+		break;
+	}
 
-	if(loc != mListenerRegistry.end())
-		mListenerRegistry.erase(loc);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned int interrupts = ring->mInterruptCount.load();
+	Shard& shard = getShard(tag);
+	auto ready = [ring, interrupts]() { return (ring->mRing.getSize() < ring->mRing.getCapacity()) || (ring->mInterruptCount.load() != interrupts); };
+	while (pushed != count)
+	{
+		{
+			std::unique_lock<std::mutex> lock(shard.mMutex);
+			ring->mSpaceWaiterCount.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ring->mSpaceCondition.wait(lock, ready);
+			ring->mSpaceWaiterCount.fetch_sub(1);
+		}
+		if (ring->mInterruptCount.load() != interrupts)
+			break;
+
+		// the consumer has to be woken for every part, or a full ring would never drain
+		std::size_t part = ring->mRing.push(tuples + pushed, count - pushed);
+		if (part != 0)
+		{
+			signal(tag, ring);
+			countPuts(ring, part);
+		}
+		pushed += part;
+	}
+	ring->mBlockedTime.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	return pushed;
+}
+
+std::size_t TupleSpace::admit(Channel* channel, ShardLock& lock, Tuple* const* tuples, std::size_t count, unsigned long long* sequences)
+{
+	for (std::size_t i = 0; i != count; ++i)
+	{
+		if (sequences != nullptr)
+			sequences[i] = channel->mFirst + channel->mQueue.size();
 
-	mMutex.unlock();
+		if ((channel->mCapacity == 0) || (channel->mCount < channel->mCapacity))
+		{
+			if (!append(channel, tuples[i]))
+				return i;
+			continue;
+		}
+
+		switch (channel->mOverflow)
+		{
+		case DROP_OLDEST:
+			delete remove(channel, 0, false);
+			++channel->mDropCount;
+			if (!append(channel, tuples[i]))
+				return i;
+			break;
+		case DROP_NEWEST:
+			delete tuples[i];
+			++channel->mDropCount;
+			// a dropped tuple gets a sequence number no queued tuple can have
+			if (sequences != nullptr)
+				sequences[i] = std::numeric_limits<unsigned long long>::max();
+			break;
+		case FAIL:
+			channel->mDropCount += count - i;
+			return i;
+		default:
+			{
+				// whatever part of the batch is already queued may be what the consumers need to make room
+				if (channel->mWaiterCount != 0)
+					channel->mCondition.notify_all();
+				unsigned int interrupts = channel->mInterruptCount;
+				auto ready = [channel, interrupts]() { return (channel->mCapacity == 0) || (channel->mCount < channel->mCapacity) || (channel->mInterruptCount != interrupts); };
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				++channel->mBlockedCount;
+				lock.wait(channel->mSpaceCondition, ready);
+				--channel->mBlockedCount;
+				channel->mBlockedTime += std::chrono::steady_clock::now() - start;
+				if (channel->mInterruptCount != interrupts)
+					return i;
+				if (sequences != nullptr)
+					sequences[i] = channel->mFirst + channel->mQueue.size();
+				if (!append(channel, tuples[i]))
+					return i;
+			}
+			break;
+		}
+	}
+	return count;
+}
+
+Tuple * TupleSpace::wait(Shard& shard, TagId tag, ShardLock& lock, const std::chrono::steady_clock::time_point* deadline)
+{
+	RingChannel* ring = getRing(tag);
+	if (ring != nullptr)
+	{
+		Tuple * t = ring->mRing.pop();
+		if (t != nullptr)
+		{
+			release(tag, ring, true);
+			countGets(ring, 1);
+			return t;
+		}
+		unsigned int interrupts = ring->mInterruptCount;
+		auto ready = [ring, interrupts]() { return (!ring->mRing.isEmpty()) || (ring->mInterruptCount != interrupts); };
+		ring->mWaiterCount.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (deadline == nullptr)
+			lock.wait(ring->mCondition, ready);
+		else
+			lock.waitUntil(ring->mCondition, *deadline, ready);
+		ring->mWaiterCount.fetch_sub(1);
+		if (ring->mInterruptCount != interrupts)
+			return nullptr;
+		t = ring->mRing.pop();
+		if (t != nullptr)
+		{
+			release(tag, ring, true);
+			countGets(ring, 1);
+		}
+		return t;
+	}
+
+	Channel* channel = getChannel(shard, tag);
+	lock.charge(channel);
+	if (!channel->mQueue.empty())
+		return remove(channel, 0);
+
+	unsigned int interrupts = channel->mInterruptCount;
+	auto ready = [channel, interrupts]() { return (!channel->mQueue.empty()) || (channel->mInterruptCount != interrupts); };
+	++channel->mWaiterCount;
+	if (deadline == nullptr)
+		lock.wait(channel->mCondition, ready);
+	else
+		lock.waitUntil(channel->mCondition, *deadline, ready);
+	--channel->mWaiterCount;
+
+	if ((channel->mInterruptCount != interrupts) || (channel->mQueue.empty()))
+	{
+		if ((!channel->mQueue.empty()) && (channel->mWaiterCount != 0))
+		{
+			// a put may have picked this waiter, so its wakeup is handed on
+			channel->mCondition.notify_one();
+		}
+		return nullptr;
+	}
+	return remove(channel, 0);
+}
+
+std::uint64_t TupleSpace::getCommit(Channel* channel)
+{
+	return (channel->mDurability == SYNCED) ? channel->mLogPosition : 0;
+}
+
+bool TupleSpace::append(Channel* channel, Tuple * t, bool logged)
+{
+	unsigned long long sequence = channel->mFirst + channel->mQueue.size();
+	// a durable tag only takes what the log does, or a crash would lose tuples nobody was told about
+	if ((logged) && (channel->mDurability != MEMORY))
+	{
+		std::uint64_t position = mLog.logPut(channel->mLogName, sequence, t);
+		if (position == 0)
+			return false;
+		channel->mLogPosition = position;
+	}
+
+	for (std::size_t i = 0; i != channel->mIndexes.size(); ++i)
+	{
+		Index& index = channel->mIndexes[i];
+		if (index.mField < t->getSize())
+			index.mEntries[t->getItemHash(index.mField)].push_back(sequence);
+	}
+	channel->mQueue.push_back(t);
+	++channel->mCount;
+
+	if (!mMetricsEnabled.load(std::memory_order_relaxed))
+	{
+		channel->mQueue.getStamp(channel->mQueue.size() - 1) = std::chrono::steady_clock::time_point();
+		return true;
+	}
+	channel->mQueue.getStamp(channel->mQueue.size() - 1) = std::chrono::steady_clock::now();
+	++channel->mCounters.mPutCount;
+	if (channel->mCount > channel->mCounters.mMaxDepth)
+		channel->mCounters.mMaxDepth = channel->mCount;
+	return true;
+}
+
+std::size_t TupleSpace::withdraw(Shard& shard, TagId tag, Tuple* const* tuples, const unsigned long long* sequences, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	Channel* channel = getChannel(shard, tag);
+	// only the last tuples can go back to the caller, so this stops at the first one a consumer took
+	while (count != 0)
+	{
+		unsigned long long sequence = sequences[count - 1];
+		if ((sequence < channel->mFirst) || (sequence - channel->mFirst >= channel->mQueue.size()))
+			break;
+		std::size_t position = static_cast<std::size_t>(sequence - channel->mFirst);
+		if (channel->mQueue[position] != tuples[count - 1])
+			break;
+		remove(channel, position, false);
+		--count;
+	}
+	return count;
+}
+
+Tuple * TupleSpace::remove(Channel* channel, std::size_t position, bool taken)
+{
+	Tuple * t = channel->mQueue[position];
+	if ((taken) && (mMetricsEnabled.load(std::memory_order_relaxed)))
+	{
+		// tuples queued while metrics were off have no stamp
+		std::chrono::steady_clock::time_point stamp = channel->mQueue.getStamp(position);
+		++channel->mCounters.mGetCount;
+		if (stamp != std::chrono::steady_clock::time_point())
+			++channel->mCounters.mAges[getAgeBucket(std::chrono::steady_clock::now() - stamp)];
+	}
+
+	unsigned long long sequence = channel->mFirst + position;
+	for (std::size_t i = 0; i != channel->mIndexes.size(); ++i)
+	{
+		Index& index = channel->mIndexes[i];
+		if (index.mField >= t->getSize())
+			continue;
+		std::unordered_map<std::size_t, std::deque<unsigned long long>>::iterator entry = index.mEntries.find(t->getItemHash(index.mField));
+		if (entry == index.mEntries.end())
+			continue;
+		// tuples mostly leave in order, so the sequence number is usually the first one
+		std::deque<unsigned long long>& sequences = entry->second;
+		for (std::deque<unsigned long long>::iterator iter = sequences.begin(); iter != sequences.end(); ++iter)
+		{
+			if (*iter == sequence)
+			{
+				sequences.erase(iter);
+				break;
+			}
+		}
+		if (sequences.empty())
+			index.mEntries.erase(entry);
+	}
+
+	if (channel->mDurability != MEMORY)
+		channel->mLogPosition = mLog.logGet(channel->mLogName, sequence);
+
+	--channel->mCount;
+	if (channel->mBlockedCount != 0)
+		channel->mSpaceCondition.notify_one();
+
+	if (position != 0)
+	{
+		channel->mQueue[position] = nullptr;
+		return t;
+	}
+	channel->mQueue.pop_front();
+	++channel->mFirst;
+	while ((!channel->mQueue.empty()) && (channel->mQueue.front() == nullptr))
+	{
+		channel->mQueue.pop_front();
+		++channel->mFirst;
+	}
+	return t;
+}
+
+std::size_t TupleSpace::find(Channel* channel, const TupleTemplate& pattern)
+{
+	for (std::size_t i = 0; i != channel->mIndexes.size(); ++i)
+	{
+		Index& index = channel->mIndexes[i];
+		if (!pattern.isActual(index.mField))
+			continue;
+		std::unordered_map<std::size_t, std::deque<unsigned long long>>::iterator entry = index.mEntries.find(pattern.getItemHash(index.mField));
+		if (entry == index.mEntries.end())
+			return channel->mQueue.size();
+		// the index only holds queued tuples, oldest first, which still have to really match
+		std::deque<unsigned long long>& sequences = entry->second;
+		for (std::deque<unsigned long long>::iterator iter = sequences.begin(); iter != sequences.end(); ++iter)
+		{
+			std::size_t position = static_cast<std::size_t>(*iter - channel->mFirst);
+			if (pattern.matches(channel->mQueue[position]))
+				return position;
+		}
+		return channel->mQueue.size();
+	}
+
+	for (std::size_t i = 0; i != channel->mQueue.size(); ++i)
+	{
+		if ((channel->mQueue[i] != nullptr) && (pattern.matches(channel->mQueue[i])))
+			return i;
+	}
+	return channel->mQueue.size();
+}
+
+Tuple * TupleSpace::match(TagId tag, const TupleTemplate& pattern, bool remove, bool block)
+{
+	Shard& shard = getShard(tag);
+	ShardLock lock(this, shard);
+	if (getRing(tag) != nullptr)
+		return nullptr;
+	Channel* channel = getChannel(shard, tag);
+	lock.charge(channel);
+	std::size_t position = find(channel, pattern);
+	if ((block) && (position == channel->mQueue.size()))
+	{
+		unsigned int interrupts = channel->mInterruptCount;
+		auto ready = [this, channel, &pattern, &position, interrupts]() { position = find(channel, pattern); return (position != channel->mQueue.size()) || (channel->mInterruptCount != interrupts); };
+		++channel->mWaiterCount;
+		++channel->mMatcherCount;
+		lock.wait(channel->mCondition, ready);
+		--channel->mMatcherCount;
+		--channel->mWaiterCount;
+		if (channel->mInterruptCount != interrupts)
+			position = channel->mQueue.size();
+	}
+
+	Tuple * t = nullptr;
+	if (position != channel->mQueue.size())
+	{
+		if (remove)
+			t = this->remove(channel, position);
+		else
+			t = new Tuple(channel->mQueue[position], "");
+	}
+	return t;
+}
+
+void TupleSpace::countPuts(RingChannel* ring, std::size_t pushed)
+{
+	if (!mMetricsEnabled.load(std::memory_order_relaxed))
+		return;
+	ring->mPutCount.fetch_add(pushed, std::memory_order_relaxed);
+	std::size_t depth = ring->mRing.getSize();
+	std::size_t maximum = ring->mMaxDepth.load(std::memory_order_relaxed);
+	while ((depth > maximum) && (!ring->mMaxDepth.compare_exchange_weak(maximum, depth, std::memory_order_relaxed)));
+}
+
+void TupleSpace::countGets(RingChannel* ring, std::size_t taken)
+{
+	if (mMetricsEnabled.load(std::memory_order_relaxed))
+		ring->mGetCount.fetch_add(taken, std::memory_order_relaxed);
+}
+
+unsigned int TupleSpace::getAgeBucket(std::chrono::steady_clock::duration age)
+{
+	long long microseconds = std::chrono::duration_cast<std::chrono::microseconds>(age).count();
+	unsigned int bucket = 0;
+	while ((microseconds > 0) && (bucket != TUPLE_SPACE_AGE_BUCKETS - 1))
+	{
+		microseconds >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void TupleSpace::setMetricsEnabled(bool enabled)
+{
+	mMetricsEnabled.store(enabled);
+}
+
+bool TupleSpace::getMetricsEnabled() const
+{
+	return mMetricsEnabled.load();
+}
+
+std::vector<TupleSpace::TagMetrics> TupleSpace::getMetrics()
+{
+	std::vector<std::string> names;
+	{
+		std::shared_lock<std::shared_timed_mutex> lock(mTagMutex);
+		names = mTagNames;
+	}
+
+	std::vector<TagMetrics> metrics;
+	for (TagId tag = 0; tag != names.size(); ++tag)
+	{
+		TagMetrics entry;
+		entry.mTag = tag;
+		entry.mName = names[tag];
+		RingChannel* ring = getRing(tag);
+		if (ring != nullptr)
+		{
+			entry.mRing = true;
+			entry.mPutCount = ring->mPutCount.load();
+			entry.mGetCount = ring->mGetCount.load();
+			entry.mDepth = ring->mRing.getSize();
+			entry.mMaxDepth = ring->mMaxDepth.load();
+			entry.mDropCount = ring->mDropCount.load();
+			entry.mBlockedTime = std::chrono::microseconds(ring->mBlockedTime.load());
+			for (unsigned int i = 0; i != TUPLE_SPACE_AGE_BUCKETS; ++i)
+				entry.mAges[i] = 0;
+			entry.mLockCount = 0;
+			entry.mLockWaitTime = std::chrono::microseconds(0);
+			entry.mLockHoldTime = std::chrono::microseconds(0);
+			metrics.push_back(entry);
+			continue;
+		}
+
+		Shard& shard = getShard(tag);
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		std::unordered_map<TagId, Channel*>::iterator iter = shard.mSpace.find(tag);
+		if (iter == shard.mSpace.end())
+			continue;
+		Channel* channel = iter->second;
+		entry.mRing = false;
+		entry.mPutCount = channel->mCounters.mPutCount;
+		entry.mGetCount = channel->mCounters.mGetCount;
+		entry.mDepth = channel->mCount;
+		entry.mMaxDepth = channel->mCounters.mMaxDepth;
+		entry.mDropCount = channel->mDropCount;
+		entry.mBlockedTime = std::chrono::duration_cast<std::chrono::microseconds>(channel->mBlockedTime);
+		for (unsigned int i = 0; i != TUPLE_SPACE_AGE_BUCKETS; ++i)
+			entry.mAges[i] = channel->mCounters.mAges[i];
+		entry.mLockCount = channel->mCounters.mLockCount;
+		entry.mLockWaitTime = std::chrono::duration_cast<std::chrono::microseconds>(channel->mCounters.mLockWaitTime);
+		entry.mLockHoldTime = std::chrono::duration_cast<std::chrono::microseconds>(channel->mCounters.mLockHoldTime);
+		metrics.push_back(entry);
+	}
+	return metrics;
+}
+
+void TupleSpace::dumpMetrics(std::ostream& stream)
+{
+	std::vector<TagMetrics> metrics = getMetrics();
+	long long time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	for (std::size_t i = 0; i != metrics.size(); ++i)
+	{
+		const TagMetrics& entry = metrics[i];
+		std::string name;
+		for (std::size_t j = 0; j != entry.mName.size(); ++j)
+		{
+			if ((entry.mName[j] == '"') || (entry.mName[j] == '\\'))
+				name.push_back('\\');
+			name.push_back(entry.mName[j]);
+		}
+		stream << "{\"time\":" << time << ",\"tag\":\"" << name << "\",\"ring\":" << (entry.mRing ? "true" : "false");
+		stream << ",\"puts\":" << entry.mPutCount << ",\"gets\":" << entry.mGetCount << ",\"depth\":" << entry.mDepth << ",\"maxDepth\":" << entry.mMaxDepth;
+		stream << ",\"drops\":" << entry.mDropCount << ",\"blockedUs\":" << entry.mBlockedTime.count();
+		stream << ",\"locks\":" << entry.mLockCount << ",\"lockWaitUs\":" << entry.mLockWaitTime.count() << ",\"lockHoldUs\":" << entry.mLockHoldTime.count();
+		stream << ",\"ages\":[";
+		for (unsigned int j = 0; j != TUPLE_SPACE_AGE_BUCKETS; ++j)
+			stream << ((j == 0) ? "" : ",") << entry.mAges[j];
+		stream << "]}" << std::endl;
+	}
+}
+
+void TupleSpace::setMetricsDump(const std::string& path, std::chrono::milliseconds period)
+{
+	if (mDumpThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mDumpMutex);
+			mDumpStop = true;
+		}
+		mDumpCondition.notify_all();
+		mDumpThread.join();
+		mDumpStop = false;
+	}
+	if (period.count() <= 0)
+		return;
+	setMetricsEnabled(true);
+	mDumpThread = std::thread(&TupleSpace::runMetricsDump, this, path, period);
+}
+
+void TupleSpace::runMetricsDump(std::string path, std::chrono::milliseconds period)
+{
+	std::unique_lock<std::mutex> lock(mDumpMutex);
+	while (!mDumpCondition.wait_for(lock, period, [this]() { return mDumpStop; }))
+	{
+		lock.unlock();
+		if (path.empty())
+		{
+			dumpMetrics(std::cout);
+		}
+		else
+		{
+			std::ofstream file(path.c_str(), std::ios::app);
+			dumpMetrics(file);
+		}
+		lock.lock();
+	}
+}
+
+TupleSpace::ShardLock::ShardLock(TupleSpace* space, Shard& shard) :
+	mTimed(space->mMetricsEnabled.load(std::memory_order_relaxed)),
+	mLock(shard.mMutex, std::defer_lock),
+	mChannel(nullptr),
+	mWaited(0),
+	mHeld(0)
+{
+	if (!mTimed)
+	{
+		mLock.lock();
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mLock.lock();
+	mAcquired = std::chrono::steady_clock::now();
+	mWaited = mAcquired - start;
+}
+
+TupleSpace::ShardLock::~ShardLock()
+{
+	if (mLock.owns_lock())
+		unlock();
+}
+
+void TupleSpace::ShardLock::charge(Channel* channel)
+{
+	mChannel = channel;
+}
+
+void TupleSpace::ShardLock::unlock()
+{
+	if ((mTimed) && (mChannel != nullptr))
+	{
+		pause();
+		mChannel->mCounters.mLockWaitTime += mWaited;
+		mChannel->mCounters.mLockHoldTime += mHeld;
+		++mChannel->mCounters.mLockCount;
+	}
+	mChannel = nullptr;
+	mLock.unlock();
+}
+
+void TupleSpace::ShardLock::pause()
+{
+	if (mTimed)
+		mHeld += std::chrono::steady_clock::now() - mAcquired;
+}
+
+void TupleSpace::ShardLock::resume()
+{
+	if (mTimed)
+		mAcquired = std::chrono::steady_clock::now();
 }
@@ -0,0 +1,95 @@
+#include <TupleSpace/TupleTemplate.hpp>
+#include <cctype>
+
+TupleTemplate::TupleTemplate(const char* code, ...)
+{
+	va_list list;
+	va_start(list, code);
+	for (; (code != nullptr) && (*code != '\0'); ++code)
+	{
+		Tuple::Item item = Tuple::Item();
+		if (*code != '?')
+		{
+			if (isupper(*code))
+			{
+				// a type wildcard takes no argument, so its code is only checked
+				if (std::string("bifdclusv").find(static_cast<char>(tolower(*code))) == std::string::npos)
+				{
+					continue;
+				}
+			}
+			else if (!Tuple::createItem(*code, &list, item))
+			{
+				continue;
+			}
+		}
+		mCode.push_back(*code);
+		mItems.push_back(item);
+	}
+	va_end(list);
+}
+
+TupleTemplate::~TupleTemplate()
+{
+	for (unsigned int i = 0; i != getSize(); ++i)
+	{
+		if (isActual(i))
+		{
+			Tuple::destroyItem(mCode[i], mItems[i]);
+		}
+	}
+	mItems.clear();
+}
+
+bool TupleTemplate::matches(const Tuple* t) const
+{
+	if ((t == nullptr) || (t->getSize() != getSize()))
+	{
+		return false;
+	}
+	for (unsigned int i = 0; i != getSize(); ++i)
+	{
+		if (mCode[i] == '?')
+		{
+			continue;
+		}
+		char code = t->getItemCode(i);
+		if (isupper(mCode[i]))
+		{
+			if (tolower(mCode[i]) != code)
+			{
+				return false;
+			}
+			continue;
+		}
+		if ((mCode[i] != code) || (!Tuple::isItemEqual(mCode[i], &mItems[i], t->getItem(i))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TupleTemplate::isActual(unsigned int index) const
+{
+	return ((index < mCode.size()) && (islower(mCode[index])));
+}
+
+std::size_t TupleTemplate::getItemHash(unsigned int index) const
+{
+	if (!isActual(index))
+	{
+		return 0;
+	}
+	return Tuple::hashItem(mCode[index], &mItems[index]);
+}
+
+unsigned int TupleTemplate::getSize() const
+{
+	return static_cast<unsigned int>(mItems.size());
+}
+
+const std::string& TupleTemplate::getCode() const
+{
+	return mCode;
+}